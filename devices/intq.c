@@ -2,7 +2,6 @@
 #include <debug.h>
 #include "threads/thread.h"
 
-static int next (int pos);
 static void wait (struct intq *q, struct thread **waiter);
 static void signal (struct intq *q, struct thread **waiter);
 
@@ -12,7 +11,7 @@ intq_init (struct intq *q)
 {
   lock_init (&q->lock);
   q->not_full = q->not_empty = NULL;
-  q->head = q->tail = 0;
+  ring_init (&q->ring, q->buf, INTQ_BUFSIZE);
 }
 
 /* Returns true if Q is empty, false otherwise. */
@@ -20,7 +19,7 @@ bool
 intq_empty (const struct intq *q) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  return q->head == q->tail;
+  return ring_empty (&q->ring);
 }
 
 /* Returns true if Q is full, false otherwise. */
@@ -28,7 +27,7 @@ bool
 intq_full (const struct intq *q) 
 {
   ASSERT (intr_get_level () == INTR_OFF);
-  return next (q->head) == q->tail;
+  return ring_full (&q->ring);
 }
 
 /* Removes a byte from Q and returns it.
@@ -48,8 +47,7 @@ intq_getc (struct intq *q)
       lock_release (&q->lock);
     }
   
-  byte = q->buf[q->tail];
-  q->tail = next (q->tail);
+  ring_read (&q->ring, &byte, 1);
   signal (q, &q->not_full);
   return byte;
 }
@@ -69,16 +67,24 @@ intq_putc (struct intq *q, uint8_t byte)
       lock_release (&q->lock);
     }
 
-  q->buf[q->head] = byte;
-  q->head = next (q->head);
+  ring_write (&q->ring, &byte, 1);
   signal (q, &q->not_empty);
 }
 
-/* Returns the position after POS within an intq. */
-static int
-next (int pos) 
+/* Removes up to CNT bytes from Q into BUF, without sleeping, and
+   returns the number removed, which is 0 if Q is empty.  Lets an
+   interrupt handler drain a queue in bulk. */
+size_t
+intq_read (struct intq *q, void *buf, size_t cnt)
 {
-  return (pos + 1) % INTQ_BUFSIZE;
+  size_t n;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  n = ring_read (&q->ring, buf, cnt);
+  if (n > 0)
+    signal (q, &q->not_full);
+  return n;
 }
 
 /* WAITER must be the address of Q's not_empty or not_full
@@ -0,0 +1,173 @@
+#include "devices/ring.h"
+#include <debug.h>
+#include <string.h>
+#include "threads/synch.h"
+
+/* `head' and `tail' count bytes ever written and read, and are
+   reduced modulo the buffer size only to index the buffer.
+   Because the size is a power of 2, that stays correct when the
+   counts wrap around, and `head - tail' is always the number of
+   bytes in the ring, so that the ring can be filled completely.
+
+   The producer copies data in and only then advances `head'; the
+   consumer copies data out and only then advances `tail'.  The
+   optimization barriers keep the compiler from reordering the
+   index update before the copy.  That is all the ordering a
+   single x86 CPU needs, since an interrupt handler sees memory
+   operations in program order.
+
+   A record is stored as its size, as a size_t, followed by its
+   bytes.  Either may wrap around the end of the buffer. */
+
+static void copy_in (struct ring *, size_t pos, const void *, size_t);
+static void copy_out (const struct ring *, size_t pos, void *, size_t);
+
+/* Initializes R as an empty ring that uses the SIZE bytes in
+   BUF.  SIZE must be a power of 2. */
+void
+ring_init (struct ring *r, void *buf, size_t size)
+{
+  ASSERT (r != NULL);
+  ASSERT (buf != NULL);
+  ASSERT (size > 0 && (size & (size - 1)) == 0);
+
+  r->buf = buf;
+  r->size = size;
+  r->head = r->tail = 0;
+}
+
+/* Returns the number of bytes in R. */
+size_t
+ring_used (const struct ring *r)
+{
+  return r->head - r->tail;
+}
+
+/* Returns the number of bytes that could be added to R. */
+size_t
+ring_room (const struct ring *r)
+{
+  return r->size - ring_used (r);
+}
+
+/* Returns true if R holds no data, false otherwise. */
+bool
+ring_empty (const struct ring *r)
+{
+  return ring_used (r) == 0;
+}
+
+/* Returns true if R has no room for more data, false
+   otherwise. */
+bool
+ring_full (const struct ring *r)
+{
+  return ring_room (r) == 0;
+}
+
+/* Adds up to CNT bytes from BUF to R, as many as there is room
+   for, and returns the number added.  Producer only. */
+size_t
+ring_write (struct ring *r, const void *buf, size_t cnt)
+{
+  size_t head = r->head;
+  size_t room = r->size - (head - r->tail);
+
+  if (cnt > room)
+    cnt = room;
+  copy_in (r, head, buf, cnt);
+  barrier ();
+  r->head = head + cnt;
+  return cnt;
+}
+
+/* Removes up to CNT bytes from R into BUF, as many as R holds,
+   and returns the number removed.  Consumer only. */
+size_t
+ring_read (struct ring *r, void *buf, size_t cnt)
+{
+  size_t tail = r->tail;
+  size_t used = r->head - tail;
+
+  if (cnt > used)
+    cnt = used;
+  barrier ();
+  copy_out (r, tail, buf, cnt);
+  barrier ();
+  r->tail = tail + cnt;
+  return cnt;
+}
+
+/* Adds the SIZE-byte record in REC to R, which takes SIZE bytes
+   plus the size of a size_t.  Returns true if successful, false
+   if there is not room for the whole record, in which case none
+   of it is added.  SIZE must be nonzero.  Producer only. */
+bool
+ring_put (struct ring *r, const void *rec, size_t size)
+{
+  size_t head = r->head;
+
+  ASSERT (size > 0);
+
+  if (r->size - (head - r->tail) < sizeof size + size)
+    return false;
+  copy_in (r, head, &size, sizeof size);
+  copy_in (r, head + sizeof size, rec, size);
+  barrier ();
+  r->head = head + sizeof size + size;
+  return true;
+}
+
+/* Returns the size of the next record in R, or 0 if R holds no
+   records.  Consumer only. */
+size_t
+ring_peek_size (const struct ring *r)
+{
+  size_t size;
+
+  if (r->head == r->tail)
+    return 0;
+  barrier ();
+  copy_out (r, r->tail, &size, sizeof size);
+  return size;
+}
+
+/* Removes the next record from R and copies up to MAX bytes of
+   it into REC, discarding any more.  Returns the record's full
+   size, or 0 if R holds no records.  Consumer only. */
+size_t
+ring_get (struct ring *r, void *rec, size_t max)
+{
+  size_t tail = r->tail;
+  size_t size = ring_peek_size (r);
+
+  if (size > 0)
+    {
+      copy_out (r, tail + sizeof size, rec, size < max ? size : max);
+      barrier ();
+      r->tail = tail + sizeof size + size;
+    }
+  return size;
+}
+
+/* Copies the CNT bytes in BUF into R's buffer at position POS. */
+static void
+copy_in (struct ring *r, size_t pos, const void *buf, size_t cnt)
+{
+  size_t ofs = pos & (r->size - 1);
+  size_t first = r->size - ofs < cnt ? r->size - ofs : cnt;
+
+  memcpy (r->buf + ofs, buf, first);
+  memcpy (r->buf, (const uint8_t *) buf + first, cnt - first);
+}
+
+/* Copies CNT bytes from R's buffer at position POS into BUF. */
+static void
+copy_out (const struct ring *r, size_t pos, void *buf, size_t cnt)
+{
+  size_t ofs = pos & (r->size - 1);
+  size_t first = r->size - ofs < cnt ? r->size - ofs : cnt;
+
+  memcpy (buf, r->buf + ofs, first);
+  memcpy ((uint8_t *) buf + first, r->buf, cnt - first);
+}
@@ -0,0 +1,48 @@
+#ifndef DEVICES_RING_H
+#define DEVICES_RING_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* A single-producer, single-consumer ring buffer.
+
+   One side, say an interrupt handler, only writes, and the other
+   side, say a kernel thread, only reads.  Because each side
+   changes only its own index, and publishes it only after the
+   data it covers is in place, neither side needs to turn off
+   interrupts or take a lock to use the ring.  With more than one
+   producer or more than one consumer, the callers on that side
+   must serialize among themselves.
+
+   A ring carries either a stream of bytes, moved in bulk with
+   ring_write() and ring_read(), or a sequence of variable-size
+   records, moved whole with ring_put() and ring_get().  The two
+   styles must not be mixed on one ring.
+
+   The ring does not block.  A caller that must wait for data or
+   space has to arrange that itself, as devices/intq.c does. */
+
+struct ring
+  {
+    uint8_t *buf;               /* Buffer. */
+    size_t size;                /* Size of buffer, a power of 2. */
+    size_t head;                /* Bytes ever written.  Producer only. */
+    size_t tail;                /* Bytes ever read.  Consumer only. */
+  };
+
+void ring_init (struct ring *, void *buf, size_t size);
+
+size_t ring_used (const struct ring *);
+size_t ring_room (const struct ring *);
+bool ring_empty (const struct ring *);
+bool ring_full (const struct ring *);
+
+size_t ring_write (struct ring *, const void *, size_t);
+size_t ring_read (struct ring *, void *, size_t);
+
+bool ring_put (struct ring *, const void *, size_t);
+size_t ring_peek_size (const struct ring *);
+size_t ring_get (struct ring *, void *, size_t);
+
+#endif /* devices/ring.h */
@@ -44,9 +44,19 @@
 /* MODEM Control Register. */
 #define MCR_OUT2 0x08           /* Output line 2. */
 
+/* Interrupt Identification Register bits. */
+#define IIR_FIFO 0xc0           /* FIFOs are enabled. */
+
+/* FIFO Control Register bits. */
+#define FCR_ENABLE 0x01         /* Enable receive and transmit FIFOs. */
+
 /* Line Status Register. */
 #define LSR_DR 0x01             /* Data Ready: received data byte is in RBR. */
 #define LSR_THRE 0x20           /* THR Empty. */
+#define LSR_TEMT 0x40           /* Transmitter empty, THR and shifter both. */
+
+/* Size of the 16550A's transmit FIFO, in bytes. */
+#define XMIT_FIFO_SIZE 16
 
 /* Transmission mode. */
 static enum { UNINIT, POLL, QUEUE } mode;
@@ -54,6 +64,10 @@ static enum { UNINIT, POLL, QUEUE } mode;
 /* Data to be transmitted. */
 static struct intq txq;
 
+/* Bytes that may be written at once when THR is empty: the size
+   of the transmit FIFO, or 1 if there is none. */
+static size_t xmit_burst = 1;
+
 static void set_serial (int bps);
 static void putc_poll (uint8_t);
 static void write_ier (void);
@@ -90,6 +104,17 @@ serial_init_queue (void)
   intr_register_ext (0x20 + 4, serial_interrupt, "serial");
   mode = QUEUE;
   old_level = intr_disable ();
+
+  /* Turn on the FIFOs, if the UART has them, so that each
+     transmit interrupt can send a whole FIFO's worth of bytes.
+     Changing the FIFO mode clears the FIFOs, so first let any
+     byte sent by polling finish. */
+  while ((inb (LSR_REG) & LSR_TEMT) == 0)
+    continue;
+  outb (FCR_REG, FCR_ENABLE);
+  if ((inb (IIR_REG) & IIR_FIFO) == IIR_FIFO)
+    xmit_burst = XMIT_FIFO_SIZE;
+
   write_ier ();
   intr_set_level (old_level);
 }
@@ -218,10 +243,14 @@ serial_interrupt (struct intr_frame *f UNUSED)
   while (!input_full () && (inb (LSR_REG) & LSR_DR) != 0)
     input_putc (inb (RBR_REG));
 
-  /* As long as we have a byte to transmit, and the hardware is
-     ready to accept a byte for transmission, transmit a byte. */
-  while (!intq_empty (&txq) && (inb (LSR_REG) & LSR_THRE) != 0) 
-    outb (THR_REG, intq_getc (&txq));
+  /* If the hardware is ready to accept bytes for transmission,
+     give it as many as we have, up to what its FIFO holds. */
+  if ((inb (LSR_REG) & LSR_THRE) != 0)
+    {
+      uint8_t buf[XMIT_FIFO_SIZE];
+      size_t cnt = intq_read (&txq, buf, xmit_burst);
+      outsb (THR_REG, buf, cnt);
+    }
 
   /* Update interrupt enable register based on queue status. */
   write_ier ();
@@ -1,5 +1,6 @@
 #include "devices/timer.h"
 #include <debug.h>
+#include <heap.h>
 #include <inttypes.h>
 #include <round.h>
 #include <stdio.h>
@@ -20,6 +21,20 @@
 /* Number of timer ticks since OS booted. */
 static int64_t ticks;
 
+/* A thread blocked in timer_sleep(). */
+struct sleeper
+  {
+    struct heap_elem elem;      /* Element in `sleepers'. */
+    int64_t wakeup;             /* Tick at which to wake up. */
+    struct semaphore sema;      /* Up'd by the timer interrupt. */
+  };
+
+/* Sleeping threads, soonest wakeup first.  Protected by
+   disabling interrupts, since the timer interrupt wakes them. */
+static struct heap sleepers;
+
+static heap_less_func wakeup_less;
+
 /* Number of loops per timer tick.
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
@@ -36,6 +51,7 @@ void
 timer_init (void) 
 {
   pit_configure_channel (0, 2, TIMER_FREQ);
+  heap_init (&sleepers, wakeup_less, NULL);
   intr_register_ext (0x20, timer_interrupt, "8254 Timer");
 }
 
@@ -85,15 +101,24 @@ timer_elapsed (int64_t then)
 }
 
 /* Sleeps for approximately TICKS timer ticks.  Interrupts must
-   be turned on. */
+   be turned on.  The thread blocks, rather than spinning, until
+   the timer interrupt wakes it. */
 void
 timer_sleep (int64_t ticks) 
 {
-  int64_t start = timer_ticks ();
+  struct sleeper s;
+  enum intr_level old_level;
 
   ASSERT (intr_get_level () == INTR_ON);
-  while (timer_elapsed (start) < ticks) 
-    thread_yield ();
+  if (ticks <= 0)
+    return;
+
+  sema_init (&s.sema, 0);
+  old_level = intr_disable ();
+  s.wakeup = timer_ticks () + ticks;
+  heap_push (&sleepers, &s.elem);
+  intr_set_level (old_level);
+  sema_down (&s.sema);
 }
 
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
@@ -172,6 +197,28 @@ timer_interrupt (struct intr_frame *args UNUSED)
 {
   ticks++;
   thread_tick ();
+
+  /* Wake up the threads whose time has come. */
+  while (!heap_empty (&sleepers))
+    {
+      struct sleeper *s = heap_entry (heap_min (&sleepers),
+                                      struct sleeper, elem);
+      if (s->wakeup > ticks)
+        break;
+      heap_pop_min (&sleepers);
+      sema_up (&s->sema);
+    }
+}
+
+/* Returns true if sleeper A wakes up before sleeper B. */
+static bool
+wakeup_less (const struct heap_elem *a_, const struct heap_elem *b_,
+             void *aux UNUSED)
+{
+  const struct sleeper *a = heap_entry (a_, struct sleeper, elem);
+  const struct sleeper *b = heap_entry (b_, struct sleeper, elem);
+
+  return a->wakeup < b->wakeup;
 }
 
 /* Returns true if LOOPS iterations waits for more than one timer
@@ -0,0 +1,448 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <hash.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/ring.h"
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+/* Buffer cache.
+
+   All file system reads and writes go through a cache of
+   CACHE_SIZE sectors that sits between the inode layer and the
+   block device.  Writes only mark a cached sector dirty; it is
+   written back when it is evicted or when the cache is flushed,
+   so a run of small writes to one sector costs one disk write.
+
+   Cached sectors are found through a hash table keyed by sector
+   number.  When a sector is needed that is not cached, a victim
+   is chosen by the clock algorithm: a hand sweeps the entries,
+   giving each recently used one a second chance by clearing its
+   accessed bit, and takes the first that is neither recently
+   used nor pinned.
+
+   A caller pins an entry with cache_pin(), which also locks it,
+   works on its data directly, and releases it with
+   cache_unpin().  A pinned entry is never evicted.
+
+   Locking: `cache_lock' protects `sector_index', the clock hand, and
+   every entry's `sector', `pin_cnt' and `accessed' members.  An
+   entry's own `lock' protects its data and its `valid' and
+   `dirty' members, and is only held by a thread that has the
+   entry pinned, so an unpinned entry's lock is always free.  A
+   dirty victim is written back while `cache_lock' is held, so
+   that no other thread can read its old sector from disk before
+   the new contents get there.
+
+   Read-ahead: readers that detect sequential access queue the
+   sectors they expect to need next with cache_read_ahead(), and
+   a kernel thread loads them into the cache in the background,
+   so that the reader finds them there.  The queue is a ring of
+   sector numbers with a lock for its many producers; when it is
+   full, further requests are dropped.
+
+   Write-behind: a "flusher" kernel thread wakes every
+   FLUSH_INTERVAL ticks and writes back every dirty sector, in
+   ascending sector order so that the disk head sweeps across the
+   disk once instead of seeking back and forth.  This bounds how
+   much is lost in a crash without making writers wait for the
+   disk.  cache_flush() does the same on demand, for sync and at
+   shutdown, and cache_flush_sector() writes back one sector, for
+   fsync. */
+
+/* A cached sector. */
+struct cache_entry
+  {
+    struct hash_elem elem;      /* Element in `sector_index'. */
+    block_sector_t sector;      /* Cached sector, if `in_index'. */
+    bool in_index;              /* In `sector_index'? */
+    int pin_cnt;                /* Number of threads using entry. */
+    bool accessed;              /* Used since the clock hand passed? */
+
+    struct lock lock;           /* Protects all of the below. */
+    bool valid;                 /* `data' holds the sector's contents? */
+    bool dirty;                 /* `data' newer than the disk? */
+    uint8_t data[BLOCK_SECTOR_SIZE]; /* Sector contents. */
+  };
+
+static struct cache_entry entries[CACHE_SIZE];
+static struct hash sector_index; /* Entries by sector. */
+static size_t hand;             /* Clock hand, an index into `entries'. */
+static struct lock cache_lock;  /* Protects the above. */
+static struct condition unpinned; /* Signaled when an entry is unpinned. */
+
+/* Read-ahead queue. */
+#define READ_AHEAD_QUEUE 32     /* Capacity in sectors, a power of 2. */
+static block_sector_t ra_buf[READ_AHEAD_QUEUE];
+static struct ring ra_queue;    /* Sectors to read ahead. */
+static struct lock ra_lock;     /* Serializes writers of `ra_queue'. */
+static struct semaphore ra_sema; /* Number of sectors in `ra_queue'. */
+
+/* Write-behind. */
+#define FLUSH_INTERVAL TIMER_FREQ /* Ticks between periodic flushes. */
+
+/* Statistics. */
+static unsigned long long hit_cnt;      /* Sectors found in the cache. */
+static unsigned long long miss_cnt;     /* Sectors not found. */
+static unsigned long long evict_cnt;    /* Entries reused. */
+static unsigned long long writeback_cnt; /* Dirty sectors written. */
+static unsigned long long ra_cnt;       /* Sectors read ahead. */
+static unsigned long long ra_drop_cnt;  /* Read-aheads dropped. */
+static unsigned long long flush_cnt;    /* Calls to cache_flush(). */
+
+static hash_hash_func entry_hash;
+static hash_less_func entry_less;
+static struct cache_entry *pin (block_sector_t, bool read, bool count);
+static struct cache_entry *lookup (block_sector_t);
+static struct cache_entry *evict (void);
+static void write_back (struct cache_entry *);
+static thread_func read_ahead_thread;
+static thread_func flusher_thread;
+
+/* Initializes the buffer cache. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  if (!hash_init (&sector_index, entry_hash, entry_less, NULL))
+    PANIC ("could not create buffer cache index");
+  lock_init (&cache_lock);
+  cond_init (&unpinned);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      e->in_index = false;
+      e->pin_cnt = 0;
+      e->accessed = false;
+      lock_init (&e->lock);
+      e->valid = false;
+      e->dirty = false;
+    }
+
+  ring_init (&ra_queue, ra_buf, sizeof ra_buf);
+  lock_init (&ra_lock);
+  sema_init (&ra_sema, 0);
+  thread_create ("read-ahead", PRI_DEFAULT, read_ahead_thread, NULL);
+  thread_create ("flusher", PRI_DEFAULT, flusher_thread, NULL);
+}
+
+/* Pins and locks the cache entry for SECTOR, loading it into the
+   cache if necessary, and returns it.  If READ is false, the
+   caller is about to overwrite the whole sector, so the sector
+   is not read from disk if it is not cached; its data is zeroed
+   instead.  The caller must release the entry with
+   cache_unpin(). */
+struct cache_entry *
+cache_pin (block_sector_t sector, bool read)
+{
+  return pin (sector, read, true);
+}
+
+/* Asks for SECTOR to be read into the cache in the background,
+   without waiting for it. */
+void
+cache_read_ahead (block_sector_t sector)
+{
+  /* The queue only ever holds whole sector numbers, so there is
+     either room for all of SECTOR or none of it. */
+  lock_acquire (&ra_lock);
+  if (ring_write (&ra_queue, &sector, sizeof sector) == sizeof sector)
+    sema_up (&ra_sema);
+  else
+    ra_drop_cnt++;
+  lock_release (&ra_lock);
+}
+
+/* Does the work of cache_pin().  Counts a hit or a miss if COUNT
+   is true. */
+static struct cache_entry *
+pin (block_sector_t sector, bool read, bool count)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = lookup (sector);
+  if (e != NULL)
+    {
+      if (count)
+        hit_cnt++;
+    }
+  else
+    {
+      if (count)
+        miss_cnt++;
+      while ((e = evict ()) == NULL)
+        cond_wait (&unpinned, &cache_lock);
+
+      /* Write back the old contents, if need be, and give the
+         entry to SECTOR.  Nobody else has E pinned, so its lock
+         is free. */
+      lock_acquire (&e->lock);
+      if (e->in_index)
+        {
+          if (e->dirty)
+            {
+              block_write (fs_device, e->sector, e->data);
+              writeback_cnt++;
+            }
+          hash_delete (&sector_index, &e->elem);
+          evict_cnt++;
+        }
+      e->sector = sector;
+      e->in_index = true;
+      e->valid = false;
+      e->dirty = false;
+      hash_insert (&sector_index, &e->elem);
+      lock_release (&e->lock);
+    }
+  e->pin_cnt++;
+  e->accessed = true;
+  lock_release (&cache_lock);
+
+  /* If another thread is loading the sector, this waits for it
+     to finish. */
+  lock_acquire (&e->lock);
+  if (!e->valid)
+    {
+      if (read)
+        block_read (fs_device, sector, e->data);
+      else
+        memset (e->data, 0, BLOCK_SECTOR_SIZE);
+      e->valid = true;
+    }
+  return e;
+}
+
+/* Returns the data of E, which must be pinned. */
+void *
+cache_data (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&e->lock));
+  return e->data;
+}
+
+/* Marks E, which must be pinned, as modified. */
+void
+cache_mark_dirty (struct cache_entry *e)
+{
+  ASSERT (lock_held_by_current_thread (&e->lock));
+  e->dirty = true;
+}
+
+/* Unlocks and unpins E. */
+void
+cache_unpin (struct cache_entry *e)
+{
+  lock_release (&e->lock);
+
+  lock_acquire (&cache_lock);
+  ASSERT (e->pin_cnt > 0);
+  if (--e->pin_cnt == 0)
+    cond_signal (&unpinned, &cache_lock);
+  lock_release (&cache_lock);
+}
+
+/* Copies SIZE bytes starting at offset OFS within SECTOR into
+   BUFFER. */
+void
+cache_read (block_sector_t sector, void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_pin (sector, true);
+  memcpy (buffer, e->data + ofs, size);
+  cache_unpin (e);
+}
+
+/* Copies SIZE bytes from BUFFER into SECTOR starting at offset
+   OFS.  Does not read the sector from disk if the write covers
+   all of it. */
+void
+cache_write (block_sector_t sector, const void *buffer, int ofs, int size)
+{
+  struct cache_entry *e;
+
+  ASSERT (ofs >= 0 && size >= 0 && ofs + size <= BLOCK_SECTOR_SIZE);
+
+  e = cache_pin (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  cache_unpin (e);
+}
+
+/* Writes every dirty sector in the cache to disk, in ascending
+   sector order. */
+void
+cache_flush (void)
+{
+  block_sector_t batch[CACHE_SIZE];
+  size_t cnt = 0;
+  size_t i, j;
+
+  /* Note the dirty sectors, sorted.  `dirty' is only a hint here,
+     since we do not hold the entries' locks, but a sector that was
+     written before we started was marked dirty before then.
+
+     Each sector is pinned only while it is written back, because
+     a thread that holds one entry may be waiting for another to
+     be unpinned; pinning them all at once could deadlock. */
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &entries[i];
+      if (!e->in_index || !e->dirty)
+        continue;
+
+      for (j = cnt++; j > 0 && batch[j - 1] > e->sector; j--)
+        batch[j] = batch[j - 1];
+      batch[j] = e->sector;
+    }
+  flush_cnt++;
+  lock_release (&cache_lock);
+
+  for (i = 0; i < cnt; i++)
+    cache_flush_sector (batch[i]);
+}
+
+/* Writes SECTOR to disk if it is cached and dirty. */
+void
+cache_flush_sector (block_sector_t sector)
+{
+  struct cache_entry *e;
+
+  lock_acquire (&cache_lock);
+  e = lookup (sector);
+  if (e != NULL)
+    e->pin_cnt++;
+  lock_release (&cache_lock);
+
+  if (e != NULL)
+    write_back (e);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  unsigned long long total = hit_cnt + miss_cnt;
+
+  printf ("Buffer cache: %llu hits, %llu misses (%llu%% hit rate), "
+          "%llu evictions, %llu writebacks\n",
+          hit_cnt, miss_cnt, total > 0 ? hit_cnt * 100 / total : 0,
+          evict_cnt, writeback_cnt);
+  printf ("Read-ahead: %llu sectors read, %llu requests dropped\n",
+          ra_cnt, ra_drop_cnt);
+  printf ("Write-behind: %llu flushes\n", flush_cnt);
+}
+
+/* Locks E, which the caller must have pinned, writes it to disk
+   if it is dirty, and unpins it. */
+static void
+write_back (struct cache_entry *e)
+{
+  lock_acquire (&e->lock);
+  if (e->valid && e->dirty)
+    {
+      block_write (fs_device, e->sector, e->data);
+      e->dirty = false;
+      writeback_cnt++;
+    }
+  cache_unpin (e);
+}
+
+/* Loads the sectors queued by cache_read_ahead() into the
+   cache, one at a time, skipping any that are already there. */
+static void
+read_ahead_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+      bool cached;
+
+      sema_down (&ra_sema);
+      ring_read (&ra_queue, &sector, sizeof sector);
+
+      lock_acquire (&cache_lock);
+      cached = lookup (sector) != NULL;
+      lock_release (&cache_lock);
+
+      if (!cached)
+        {
+          cache_unpin (pin (sector, true, false));
+          ra_cnt++;
+        }
+    }
+}
+
+/* Writes back the cache's dirty sectors every FLUSH_INTERVAL
+   ticks. */
+static void
+flusher_thread (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      cache_flush ();
+    }
+}
+
+/* Returns the entry for SECTOR, or a null pointer if SECTOR is
+   not cached.  Must be called with `cache_lock' held. */
+static struct cache_entry *
+lookup (block_sector_t sector)
+{
+  struct cache_entry key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&sector_index, &key.elem);
+  return e != NULL ? hash_entry (e, struct cache_entry, elem) : NULL;
+}
+
+/* Chooses an unpinned entry to reuse with the clock algorithm
+   and returns it, or returns a null pointer if every entry is
+   pinned.  Must be called with `cache_lock' held. */
+static struct cache_entry *
+evict (void)
+{
+  size_t i;
+
+  /* Two sweeps are enough: the first clears every accessed bit
+     that stands in the way. */
+  for (i = 0; i < 2 * CACHE_SIZE; i++)
+    {
+      struct cache_entry *e = &entries[hand];
+      hand = (hand + 1) % CACHE_SIZE;
+
+      if (e->pin_cnt > 0)
+        continue;
+      if (!e->in_index || !e->accessed)
+        return e;
+      e->accessed = false;
+    }
+  return NULL;
+}
+
+/* Returns a hash of the sector cached by E. */
+static unsigned
+entry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct cache_entry *c = hash_entry (e, struct cache_entry, elem);
+  return hash_int (c->sector);
+}
+
+/* Returns true if entry A caches a lower sector than entry B. */
+static bool
+entry_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct cache_entry, elem)->sector
+          < hash_entry (b, struct cache_entry, elem)->sector);
+}
@@ -0,0 +1,24 @@
+#ifndef FILESYS_CACHE_H
+#define FILESYS_CACHE_H
+
+#include <stdbool.h>
+#include "devices/block.h"
+
+/* Number of sectors in the buffer cache. */
+#define CACHE_SIZE 64
+
+struct cache_entry;
+
+void cache_init (void);
+struct cache_entry *cache_pin (block_sector_t, bool read);
+void *cache_data (struct cache_entry *);
+void cache_mark_dirty (struct cache_entry *);
+void cache_unpin (struct cache_entry *);
+void cache_read_ahead (block_sector_t);
+void cache_read (block_sector_t, void *, int ofs, int size);
+void cache_write (block_sector_t, const void *, int ofs, int size);
+void cache_flush (void);
+void cache_flush_sector (block_sector_t);
+void cache_print_stats (void);
+
+#endif /* filesys/cache.h */
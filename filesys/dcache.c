@@ -0,0 +1,205 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/synch.h"
+
+/* Directory entry cache.
+
+   Resolving a path looks up each of its components in the
+   directory before it, and every lookup reads the directory's
+   bucket for that name.  To save those reads when the same paths
+   are resolved again and again, the "dentry" cache remembers the
+   inode sector that a name in a directory, itself identified by
+   its inode sector, was last found to refer to.
+
+   The cache holds DCACHE_SIZE entries.  When it is full, the
+   least recently used entry is reused.  Only names that exist are
+   cached; directory.c removes a name's entry when it removes the
+   name, and all of a directory's entries when it removes the
+   directory, so that a reused sector never inherits stale
+   entries. */
+
+/* A cached name. */
+struct dentry
+  {
+    struct hash_elem hash_elem; /* Element in `dentry_index'. */
+    struct list_elem lru_elem;  /* Element in `lru'. */
+    bool in_index;              /* In `dentry_index'? */
+    block_sector_t dir;         /* Directory's inode sector. */
+    char name[NAME_MAX + 1];    /* Name within `dir'. */
+    block_sector_t sector;      /* Inode sector that `name' refers to. */
+  };
+
+static struct dentry dentries[DCACHE_SIZE];
+static struct hash dentry_index; /* Entries in use, by directory and name. */
+static struct list lru;         /* All entries, most recently used first. */
+static struct lock dcache_lock; /* Protects all of the above. */
+
+/* Statistics. */
+static unsigned long long hit_cnt;      /* Names found in the cache. */
+static unsigned long long miss_cnt;     /* Names not found. */
+
+static hash_hash_func dentry_hash;
+static hash_less_func dentry_less;
+static struct dentry *lookup (block_sector_t dir, const char *name);
+static void discard (struct dentry *);
+
+/* Initializes the directory entry cache. */
+void
+dcache_init (void)
+{
+  size_t i;
+
+  if (!hash_init (&dentry_index, dentry_hash, dentry_less, NULL))
+    PANIC ("could not create directory entry cache index");
+  list_init (&lru);
+  lock_init (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    {
+      dentries[i].in_index = false;
+      list_push_back (&lru, &dentries[i].lru_elem);
+    }
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   If it is cached, stores the sector of the inode that it refers
+   to into *SECTOR and returns true; otherwise returns false. */
+bool
+dcache_lookup (block_sector_t dir, const char *name, block_sector_t *sector)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = lookup (dir, name);
+  if (d != NULL)
+    {
+      list_remove (&d->lru_elem);
+      list_push_front (&lru, &d->lru_elem);
+      *sector = d->sector;
+      hit_cnt++;
+    }
+  else
+    miss_cnt++;
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Records that NAME, in the directory whose inode is in sector
+   DIR, refers to the inode in SECTOR. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dentry *d;
+
+  ASSERT (strlen (name) <= NAME_MAX);
+
+  lock_acquire (&dcache_lock);
+  d = lookup (dir, name);
+  if (d == NULL)
+    {
+      /* Reuse the least recently used entry. */
+      d = list_entry (list_back (&lru), struct dentry, lru_elem);
+      discard (d);
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      d->in_index = true;
+      hash_insert (&dentry_index, &d->hash_elem);
+    }
+  d->sector = sector;
+  list_remove (&d->lru_elem);
+  list_push_front (&lru, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets NAME in the directory whose inode is in sector DIR. */
+void
+dcache_remove (block_sector_t dir, const char *name)
+{
+  struct dentry *d;
+
+  lock_acquire (&dcache_lock);
+  d = lookup (dir, name);
+  if (d != NULL)
+    discard (d);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets every name in the directory whose inode is in sector
+   DIR. */
+void
+dcache_remove_dir (block_sector_t dir)
+{
+  size_t i;
+
+  lock_acquire (&dcache_lock);
+  for (i = 0; i < DCACHE_SIZE; i++)
+    if (dentries[i].in_index && dentries[i].dir == dir)
+      discard (&dentries[i]);
+  lock_release (&dcache_lock);
+}
+
+/* Prints directory entry cache statistics. */
+void
+dcache_print_stats (void)
+{
+  unsigned long long total = hit_cnt + miss_cnt;
+
+  printf ("Dentry cache: %llu hits, %llu misses (%llu%% hit rate)\n",
+          hit_cnt, miss_cnt, total > 0 ? hit_cnt * 100 / total : 0);
+}
+
+/* Returns the cached entry for NAME in DIR, or a null pointer if
+   there is none.  Must be called with `dcache_lock' held. */
+static struct dentry *
+lookup (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  if (strlen (name) > NAME_MAX)
+    return NULL;
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentry_index, &key.hash_elem);
+  return e != NULL ? hash_entry (e, struct dentry, hash_elem) : NULL;
+}
+
+/* Removes D from `dentry_index', if it is there, and moves it to
+   the back of `lru' for reuse.  Must be called with `dcache_lock'
+   held. */
+static void
+discard (struct dentry *d)
+{
+  if (d->in_index)
+    {
+      hash_delete (&dentry_index, &d->hash_elem);
+      d->in_index = false;
+    }
+  list_remove (&d->lru_elem);
+  list_push_back (&lru, &d->lru_elem);
+}
+
+/* Returns a hash of D's directory and name. */
+static unsigned
+dentry_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct dentry *d = hash_entry (e, struct dentry, hash_elem);
+  return hash_string (d->name) ^ hash_int (d->dir);
+}
+
+/* Returns true if dentry A orders before dentry B. */
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, hash_elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, hash_elem);
+
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
@@ -1,10 +1,14 @@
 #include "filesys/directory.h"
+#include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include <round.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
 
 /* A directory. */
 struct dir 
@@ -21,12 +25,61 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
-/* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+/* A directory is a hash table of its entries, laid out on disk
+   as an array of buckets, each one sector long.  A name is only
+   ever stored in the bucket that it hashes to, so finding,
+   adding or removing it reads just that one sector.
+
+   The table grows by linear hashing: when a name's bucket is
+   full, one more bucket is added at the end and the entries of
+   one existing bucket, taken in order, are divided between the
+   two, until the name's bucket has a free slot.  Each step
+   touches two sectors, and no step ever rehashes the whole
+   directory.
+
+   Every directory holds an entry "." for itself and an entry
+   ".." for its parent, which dir_readdir() does not report.  The
+   root directory is its own parent.  Names that are found are
+   also cached in the directory entry cache (see dcache.c), which
+   dir_lookup() consults before reading the directory. */
+
+/* Number of entries in each bucket. */
+#define ENTRIES_PER_BUCKET (BLOCK_SECTOR_SIZE / sizeof (struct dir_entry))
+
+/* Cache of open directories. */
+static struct kmem_cache *dir_cache;
+
+static bool is_empty (struct inode *);
+
+/* Initializes the directory module. */
+void
+dir_init (void)
+{
+  dir_cache = kmem_cache_create ("dir", sizeof (struct dir), NULL);
+  if (dir_cache == NULL)
+    PANIC ("could not create dir cache");
+  dcache_init ();
+}
+
+/* Creates a directory with initial space for ENTRY_CNT entries
+   in the given SECTOR, as a subdirectory of the directory whose
+   inode is in PARENT.  The directory grows as needed.
+   Returns true if successful, false on failure. */
 bool
-dir_create (block_sector_t sector, size_t entry_cnt)
+dir_create (block_sector_t sector, block_sector_t parent, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  size_t buckets = DIV_ROUND_UP (entry_cnt + 2, ENTRIES_PER_BUCKET);
+  struct dir *dir;
+  bool success;
+
+  if (!inode_create (sector, buckets * BLOCK_SECTOR_SIZE, true))
+    return false;
+  dir = dir_open (inode_open (sector));
+  success = (dir != NULL
+             && dir_add (dir, ".", sector)
+             && dir_add (dir, "..", parent));
+  dir_close (dir);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -34,7 +87,7 @@ dir_create (block_sector_t sector, size_t entry_cnt)
 struct dir *
 dir_open (struct inode *inode) 
 {
-  struct dir *dir = calloc (1, sizeof *dir);
+  struct dir *dir = kmem_cache_alloc (dir_cache);
   if (inode != NULL && dir != NULL)
     {
       dir->inode = inode;
@@ -44,7 +97,7 @@ dir_open (struct inode *inode)
   else
     {
       inode_close (inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
       return NULL; 
     }
 }
@@ -72,7 +125,7 @@ dir_close (struct dir *dir)
   if (dir != NULL)
     {
       inode_close (dir->inode);
-      free (dir);
+      kmem_cache_free (dir_cache, dir);
     }
 }
 
@@ -83,34 +136,110 @@ dir_get_inode (struct dir *dir)
   return dir->inode;
 }
 
+/* Returns the number of buckets in DIR. */
+static size_t
+bucket_cnt (const struct dir *dir)
+{
+  return inode_length (dir->inode) / BLOCK_SECTOR_SIZE;
+}
+
+/* Returns the bucket that holds names with hash value HASH in a
+   directory with CNT buckets.  Hash values are reduced modulo the
+   smallest power of 2 that is at least CNT; those that land past
+   the last bucket go to the bucket that has not been split yet,
+   modulo half that power of 2. */
+static size_t
+bucket_of (unsigned hash, size_t cnt)
+{
+  size_t level = 1;
+  size_t bucket;
+
+  while (level < cnt)
+    level *= 2;
+  bucket = hash & (level - 1);
+  return bucket < cnt ? bucket : bucket - level / 2;
+}
+
+/* Returns the byte offset of entry SLOT of bucket BUCKET. */
+static off_t
+entry_ofs (size_t bucket, size_t slot)
+{
+  return bucket * BLOCK_SECTOR_SIZE + slot * sizeof (struct dir_entry);
+}
+
 /* Searches DIR for a file with the given NAME.
    If successful, returns true, sets *EP to the directory entry
    if EP is non-null, and sets *OFSP to the byte offset of the
    directory entry if OFSP is non-null.
-   otherwise, returns false and ignores EP and OFSP. */
+   otherwise, returns false and ignores EP and OFSP.
+   Only the one bucket that NAME hashes to is searched. */
 static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
   struct dir_entry e;
-  size_t ofs;
+  size_t cnt, bucket, slot;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (e.in_use && !strcmp (name, e.name)) 
-      {
-        if (ep != NULL)
-          *ep = e;
-        if (ofsp != NULL)
-          *ofsp = ofs;
-        return true;
-      }
+  cnt = bucket_cnt (dir);
+  if (cnt == 0)
+    return false;
+  bucket = bucket_of (hash_string (name), cnt);
+  for (slot = 0; slot < ENTRIES_PER_BUCKET; slot++)
+    {
+      off_t ofs = entry_ofs (bucket, slot);
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+        break;
+      if (e.in_use && !strcmp (name, e.name)) 
+        {
+          if (ep != NULL)
+            *ep = e;
+          if (ofsp != NULL)
+            *ofsp = ofs;
+          return true;
+        }
+    }
   return false;
 }
 
+/* Adds a bucket to the end of DIR and moves into it the entries
+   of the bucket that it splits, the ones whose names now hash to
+   it.  Returns true if successful, false if DIR cannot grow. */
+static bool
+split (struct dir *dir)
+{
+  static const uint8_t zeros[BLOCK_SECTOR_SIZE];
+  size_t cnt = bucket_cnt (dir);
+  size_t slot, dst_slot = 0;
+
+  /* Hash value CNT belongs in the new bucket, so before the new
+     bucket exists it lands in the bucket to split. */
+  size_t src = bucket_of (cnt, cnt);
+
+  if (inode_write_at (dir->inode, zeros, BLOCK_SECTOR_SIZE,
+                      entry_ofs (cnt, 0)) != BLOCK_SECTOR_SIZE)
+    return false;
+
+  for (slot = 0; slot < ENTRIES_PER_BUCKET; slot++)
+    {
+      struct dir_entry e;
+      off_t ofs = entry_ofs (src, slot);
+
+      if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+          || !e.in_use || bucket_of (hash_string (e.name), cnt + 1) == src)
+        continue;
+
+      /* Copy before erasing, so that a crash in between can only
+         duplicate the entry, not lose it. */
+      inode_write_at (dir->inode, &e, sizeof e, entry_ofs (cnt, dst_slot++));
+      e.in_use = false;
+      inode_write_at (dir->inode, &e, sizeof e, ofs);
+    }
+  return true;
+}
+
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
@@ -119,13 +248,20 @@ bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector = inode_get_inumber (dir->inode);
+  block_sector_t sector;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  if (dcache_lookup (dir_sector, name, &sector))
+    *inode = inode_open (sector);
+  else if (lookup (dir, name, &e, NULL))
+    {
+      dcache_insert (dir_sector, name, e.inode_sector);
+      *inode = inode_open (e.inode_sector);
+    }
   else
     *inode = NULL;
 
@@ -143,8 +279,9 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
 
   struct dir_entry e;
-  off_t ofs;
+  off_t ofs = 0;
   bool success = false;
+  unsigned hash;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -157,17 +294,31 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (lookup (dir, name, NULL, NULL))
     goto done;
 
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
+  /* Set OFS to offset of a free slot in NAME's bucket, splitting
+     buckets until there is one.
      
      inode_read_at() will only return a short read at end of file.
      Otherwise, we'd need to verify that we didn't get a short
      read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
+  hash = hash_string (name);
+  for (;;)
+    {
+      size_t cnt = bucket_cnt (dir);
+      size_t slot = ENTRIES_PER_BUCKET;
+
+      if (cnt > 0)
+        for (slot = 0; slot < ENTRIES_PER_BUCKET; slot++)
+          {
+            ofs = entry_ofs (bucket_of (hash, cnt), slot);
+            if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e
+                || !e.in_use)
+              break;
+          }
+      if (slot < ENTRIES_PER_BUCKET)
+        break;
+      if (!split (dir))
+        goto done;
+    }
 
   /* Write slot. */
   e.in_use = true;
@@ -180,8 +331,9 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 }
 
 /* Removes any entry for NAME in DIR.
-   Returns true if successful, false on failure,
-   which occurs only if there is no file with the given NAME. */
+   Returns true if successful, false on failure, which occurs if
+   there is no file with the given NAME, if NAME is "." or "..",
+   or if NAME is a directory that is not empty or that is open. */
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
@@ -194,7 +346,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (name != NULL);
 
   /* Find directory entry. */
-  if (!lookup (dir, name, &e, &ofs))
+  if (!strcmp (name, ".") || !strcmp (name, "..")
+      || !lookup (dir, name, &e, &ofs))
     goto done;
 
   /* Open inode. */
@@ -202,11 +355,22 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
+  /* Only remove a directory that nobody else has open, not even
+     as a working directory, and that has nothing in it. */
+  if (inode_is_dir (inode)
+      && (inode_open_cnt (inode) > 1 || !is_empty (inode)))
+    goto done;
+
   /* Erase directory entry. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
 
+  /* Forget cached names. */
+  dcache_remove (inode_get_inumber (dir->inode), name);
+  if (inode_is_dir (inode))
+    dcache_remove_dir (e.inode_sector);
+
   /* Remove inode. */
   inode_remove(inode);
   success = true;
@@ -216,18 +380,25 @@ dir_remove (struct dir *dir, const char *name)
   return success;
 }
 
-/* Reads the next directory entry in DIR and stores the name in
-   NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+/* Reads the next directory entry in DIR, other than "." and
+   "..", and stores the name in NAME.  Returns true if
+   successful, false if the directory contains no more
+   entries. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
 
-  while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
+  for (;;)
     {
+      /* Skip the unused space at the end of each bucket. */
+      if (dir->pos % BLOCK_SECTOR_SIZE
+          > BLOCK_SECTOR_SIZE - (off_t) sizeof e)
+        dir->pos = ROUND_UP (dir->pos, BLOCK_SECTOR_SIZE);
+      if (inode_read_at (dir->inode, &e, sizeof e, dir->pos) != sizeof e)
+        break;
       dir->pos += sizeof e;
-      if (e.in_use)
+      if (e.in_use && strcmp (e.name, ".") && strcmp (e.name, ".."))
         {
           strlcpy (name, e.name, NAME_MAX + 1);
           return true;
@@ -235,3 +406,16 @@ dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
     }
   return false;
 }
+
+/* Returns true if the directory in INODE has no entries other
+   than "." and "..". */
+static bool
+is_empty (struct inode *inode)
+{
+  struct dir dir;
+  char name[NAME_MAX + 1];
+
+  dir.inode = inode;
+  dir.pos = 0;
+  return !dir_readdir (&dir, name);
+}
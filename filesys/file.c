@@ -1,7 +1,12 @@
 #include "filesys/file.h"
 #include <debug.h>
+#include "devices/block.h"
 #include "filesys/inode.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+
+/* Read-ahead window limits, in sectors. */
+#define READ_AHEAD_MIN 2
+#define READ_AHEAD_MAX 32
 
 /* An open file. */
 struct file 
@@ -9,26 +14,48 @@ struct file
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+
+    /* Read-ahead state. */
+    off_t ra_next;              /* Offset a sequential read starts at. */
+    off_t ra_end;               /* End of data already read ahead. */
+    int ra_window;              /* Sectors to read ahead, 0 if none. */
   };
 
+static void read_ahead (struct file *, off_t ofs, off_t size);
+
+/* Cache of open files. */
+static struct kmem_cache *file_cache;
+
+/* Initializes the file module. */
+void
+file_init (void)
+{
+  file_cache = kmem_cache_create ("file", sizeof (struct file), NULL);
+  if (file_cache == NULL)
+    PANIC ("could not create file cache");
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
 struct file *
 file_open (struct inode *inode) 
 {
-  struct file *file = calloc (1, sizeof *file);
+  struct file *file = kmem_cache_alloc (file_cache);
   if (inode != NULL && file != NULL)
     {
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = 0;
+      file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
     {
       inode_close (inode);
-      free (file);
+      kmem_cache_free (file_cache, file);
       return NULL; 
     }
 }
@@ -49,7 +76,7 @@ file_close (struct file *file)
     {
       file_allow_write (file);
       inode_close (file->inode);
-      free (file); 
+      kmem_cache_free (file_cache, file);
     }
 }
 
@@ -69,6 +96,7 @@ off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
+  read_ahead (file, file->pos, bytes_read);
   file->pos += bytes_read;
   return bytes_read;
 }
@@ -81,15 +109,16 @@ file_read (struct file *file, void *buffer, off_t size)
 off_t
 file_read_at (struct file *file, void *buffer, off_t size, off_t file_ofs) 
 {
-  return inode_read_at (file->inode, buffer, size, file_ofs);
+  off_t bytes_read = inode_read_at (file->inode, buffer, size, file_ofs);
+  read_ahead (file, file_ofs, bytes_read);
+  return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at the file's current position.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if an error occurs.
+   Writing past end of file grows the file.
    Advances FILE's position by the number of bytes read. */
 off_t
 file_write (struct file *file, const void *buffer, off_t size) 
@@ -102,9 +131,8 @@ file_write (struct file *file, const void *buffer, off_t size)
 /* Writes SIZE bytes from BUFFER into FILE,
    starting at offset FILE_OFS in the file.
    Returns the number of bytes actually written,
-   which may be less than SIZE if end of file is reached.
-   (Normally we'd grow the file in that case, but file growth is
-   not yet implemented.)
+   which may be less than SIZE if an error occurs.
+   Writing past end of file grows the file.
    The file's current position is unaffected. */
 off_t
 file_write_at (struct file *file, const void *buffer, off_t size,
@@ -140,6 +168,15 @@ file_allow_write (struct file *file)
     }
 }
 
+/* Writes any of FILE's data that has not yet reached the disk
+   to disk. */
+void
+file_sync (struct file *file)
+{
+  ASSERT (file != NULL);
+  inode_sync (file->inode);
+}
+
 /* Returns the size of FILE in bytes. */
 off_t
 file_length (struct file *file) 
@@ -166,3 +203,44 @@ file_tell (struct file *file)
   ASSERT (file != NULL);
   return file->pos;
 }
+
+/* Notes that SIZE bytes were just read from FILE at offset OFS,
+   and, if FILE is being read sequentially, asks for the data
+   that follows to be read ahead into the buffer cache.
+
+   The read-ahead window starts at READ_AHEAD_MIN sectors and
+   doubles, up to READ_AHEAD_MAX, with each read that continues
+   where the last one stopped.  A read anywhere else shuts the
+   window until sequential reading resumes.  Only data beyond
+   what was already requested is asked for, so a steady reader
+   requests each sector once. */
+static void
+read_ahead (struct file *file, off_t ofs, off_t size)
+{
+  off_t end = ofs + size;
+  off_t from, to;
+
+  if (size <= 0)
+    return;
+
+  if (ofs != file->ra_next)
+    {
+      file->ra_window = 0;
+      file->ra_end = end;
+    }
+  else if (file->ra_window == 0)
+    file->ra_window = READ_AHEAD_MIN;
+  else if (file->ra_window < READ_AHEAD_MAX)
+    file->ra_window *= 2;
+  file->ra_next = end;
+
+  if (file->ra_window == 0)
+    return;
+  from = file->ra_end > end ? file->ra_end : end;
+  to = end + file->ra_window * BLOCK_SECTOR_SIZE;
+  if (to > from)
+    {
+      inode_read_ahead (file->inode, from, to);
+      file->ra_end = to;
+    }
+}
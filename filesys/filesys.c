@@ -2,15 +2,22 @@
 #include <debug.h>
 #include <stdio.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/file.h"
 #include "filesys/free-map.h"
 #include "filesys/inode.h"
+#include "filesys/dcache.h"
 #include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/thread.h"
 
 /* Partition that contains the file system. */
 struct block *fs_device;
 
 static void do_format (void);
+static struct dir *open_parent (const char *path, char name[NAME_MAX + 1]);
+static struct dir *descend (struct dir *, const char *name);
+static block_sector_t dir_sector (struct dir *);
 
 /* Initializes the file system module.
    If FORMAT is true, reformats the file system. */
@@ -21,7 +28,10 @@ filesys_init (bool format)
   if (fs_device == NULL)
     PANIC ("No file system device found, can't initialize file system.");
 
+  cache_init ();
   inode_init ();
+  file_init ();
+  dir_init ();
   free_map_init ();
 
   if (format) 
@@ -36,6 +46,16 @@ void
 filesys_done (void) 
 {
   free_map_close ();
+  cache_flush ();
+  cache_print_stats ();
+  dcache_print_stats ();
+}
+
+/* Writes all unwritten file system data to disk. */
+void
+filesys_sync (void)
+{
+  cache_flush ();
 }
 
 /* Creates a file named NAME with the given INITIAL_SIZE.
@@ -45,19 +65,40 @@ filesys_done (void)
 bool
 filesys_create (const char *name, off_t initial_size) 
 {
+  char base[NAME_MAX + 1];
   block_sector_t inode_sector = 0;
-  struct dir *dir = dir_open_root ();
+  struct dir *dir = open_parent (name, base);
   bool success = (dir != NULL
-                  && free_map_allocate (1, &inode_sector)
-                  && inode_create (inode_sector, initial_size)
-                  && dir_add (dir, name, inode_sector));
+                  && free_map_allocate_near (dir_sector (dir), &inode_sector)
+                  && inode_create (inode_sector, initial_size, false)
+                  && dir_add (dir, base, inode_sector));
   if (!success && inode_sector != 0) 
     free_map_release (inode_sector, 1);
   dir_close (dir);
   return success;
 }
 
-/* Opens the file with the given NAME.
+/* Creates an empty directory named NAME.
+   Returns true if successful, false otherwise.
+   Fails if a file named NAME already exists,
+   or if internal memory allocation fails. */
+bool
+filesys_mkdir (const char *name)
+{
+  char base[NAME_MAX + 1];
+  block_sector_t inode_sector = 0;
+  struct dir *dir = open_parent (name, base);
+  bool success = (dir != NULL
+                  && free_map_allocate_near (dir_sector (dir), &inode_sector)
+                  && dir_create (inode_sector, dir_sector (dir), 0)
+                  && dir_add (dir, base, inode_sector));
+  if (!success && inode_sector != 0) 
+    free_map_release (inode_sector, 1);
+  dir_close (dir);
+  return success;
+}
+
+/* Opens the file with the given NAME, which may be a directory.
    Returns the new file if successful or a null pointer
    otherwise.
    Fails if no file named NAME exists,
@@ -65,11 +106,12 @@ filesys_create (const char *name, off_t initial_size)
 struct file *
 filesys_open (const char *name)
 {
-  struct dir *dir = dir_open_root ();
+  char base[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, base);
   struct inode *inode = NULL;
 
   if (dir != NULL)
-    dir_lookup (dir, name, &inode);
+    dir_lookup (dir, base, &inode);
   dir_close (dir);
 
   return file_open (inode);
@@ -77,26 +119,140 @@ filesys_open (const char *name)
 
 /* Deletes the file named NAME.
    Returns true if successful, false on failure.
-   Fails if no file named NAME exists,
-   or if an internal memory allocation fails. */
+   Fails if no file named NAME exists, if NAME is a directory
+   that is not empty or is in use, or if an internal memory
+   allocation fails. */
 bool
 filesys_remove (const char *name) 
 {
-  struct dir *dir = dir_open_root ();
-  bool success = dir != NULL && dir_remove (dir, name);
+  char base[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, base);
+  bool success = dir != NULL && dir_remove (dir, base);
   dir_close (dir); 
 
   return success;
 }
-
+
+/* Changes the running thread's working directory to NAME.
+   Returns true if successful, false if NAME does not exist or
+   is not a directory. */
+bool
+filesys_chdir (const char *name)
+{
+  struct thread *cur = thread_current ();
+  char base[NAME_MAX + 1];
+  struct dir *dir = open_parent (name, base);
+  struct inode *inode = NULL;
+
+  if (dir != NULL)
+    dir_lookup (dir, base, &inode);
+  dir_close (dir);
+
+  if (inode == NULL || !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return false;
+    }
+  dir = dir_open (inode);
+  if (dir == NULL)
+    return false;
+  dir_close (cur->cwd);
+  cur->cwd = dir;
+  return true;
+}
+
+/* Releases the running thread's working directory. */
+void
+filesys_exit (void)
+{
+  struct thread *cur = thread_current ();
+
+  dir_close (cur->cwd);
+  cur->cwd = NULL;
+}
+
+/* Opens the directory that contains the last component of PATH,
+   which may be absolute or relative to the running thread's
+   working directory, and copies that component into NAME.  For
+   "/", opens the root directory and sets NAME to ".".
+   Returns a null pointer if PATH is empty, if a component other
+   than the last does not exist or is not a directory, if the
+   last component is longer than NAME_MAX, or if memory
+   allocation fails. */
+static struct dir *
+open_parent (const char *path, char name[NAME_MAX + 1])
+{
+  struct dir *cwd = thread_current ()->cwd;
+  struct dir *dir;
+  char *copy, *token, *save_ptr;
+  size_t len = strlen (path);
+
+  if (len == 0)
+    return NULL;
+  copy = malloc (len + 1);
+  if (copy == NULL)
+    return NULL;
+  strlcpy (copy, path, len + 1);
+
+  dir = path[0] == '/' || cwd == NULL ? dir_open_root () : dir_reopen (cwd);
+  strlcpy (name, ".", NAME_MAX + 1);
+  token = strtok_r (copy, "/", &save_ptr);
+  while (dir != NULL && token != NULL)
+    {
+      char *next = strtok_r (NULL, "/", &save_ptr);
+      if (next == NULL)
+        {
+          /* TOKEN is the last component. */
+          if (strlen (token) > NAME_MAX)
+            {
+              dir_close (dir);
+              dir = NULL;
+            }
+          else
+            strlcpy (name, token, NAME_MAX + 1);
+        }
+      else
+        dir = descend (dir, token);
+      token = next;
+    }
+
+  free (copy);
+  return dir;
+}
+
+/* Closes DIR and returns its subdirectory NAME, opened, or a null
+   pointer if DIR has no subdirectory NAME. */
+static struct dir *
+descend (struct dir *dir, const char *name)
+{
+  struct inode *inode = NULL;
+
+  dir_lookup (dir, name, &inode);
+  dir_close (dir);
+  if (inode != NULL && !inode_is_dir (inode))
+    {
+      inode_close (inode);
+      return NULL;
+    }
+  return dir_open (inode);
+}
+
 /* Formats the file system. */
 static void
 do_format (void)
 {
   printf ("Formatting file system...");
   free_map_create ();
-  if (!dir_create (ROOT_DIR_SECTOR, 16))
+  if (!dir_create (ROOT_DIR_SECTOR, ROOT_DIR_SECTOR, 16))
     PANIC ("root directory creation failed");
   free_map_close ();
   printf ("done.\n");
 }
+
+/* Returns the sector of DIR's inode.  New files and directories
+   are allocated near it, to keep them close to their parent. */
+static block_sector_t
+dir_sector (struct dir *dir)
+{
+  return inode_get_inumber (dir_get_inode (dir));
+}
@@ -1,70 +1,195 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <rangetree.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
+
+/* Free map.
+
+   The bitmap, one bit per sector, is the free map that lives on
+   disk.  To avoid scanning it bit by bit, an in-memory extent
+   index mirrors it: a range tree holding each maximal run of
+   used sectors as one range.  The gaps between the ranges are
+   exactly the free extents, and the tree's gap search finds the
+   first free extent of a given length at or after a goal sector
+   in O(lg n) time, where n is the number of runs.
+
+   Allocations take a goal sector and look for free space at or
+   after it first, so that a file's sectors follow its inode and
+   each other.  free_map_allocate_extents() does not insist on a
+   single run: when no free extent is long enough, it returns
+   several shorter ones, so fragmentation alone never makes it
+   fail.
+
+   `free_map_lock' protects the bitmap and the index. */
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
+static struct lock free_map_lock;    /* Protects free map and index. */
+
+/* A run of used sectors in the extent index. */
+struct used_extent
+  {
+    struct range_elem elem;     /* Sectors [start, end). */
+  };
+
+static struct range_tree used;       /* Runs of used sectors. */
+static struct kmem_cache *extent_cache; /* Cache of used_extents. */
+
+static block_sector_t find_run (block_sector_t goal, size_t cnt);
+static bool take (block_sector_t, size_t cnt);
+static void give_back (block_sector_t, size_t cnt);
+static bool write_map (void);
+static void build_index (void);
 
 /* Initializes the free map. */
 void
-free_map_init (void) 
+free_map_init (void)
 {
   free_map = bitmap_create (block_size (fs_device));
   if (free_map == NULL)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  lock_init (&free_map_lock);
+  extent_cache = kmem_cache_create ("extent", sizeof (struct used_extent),
+                                    NULL);
+  if (extent_cache == NULL)
+    PANIC ("could not create extent cache");
+  range_init (&used);
+  build_index ();
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available or if the free_map file could not be
+   written. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-//printf("entering free_map_apllocate\n");
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  block_sector_t sector;
+  bool success = false;
+
+  lock_acquire (&free_map_lock);
+  sector = find_run (0, cnt);
+  if (sector != BITMAP_ERROR && take (sector, cnt))
+    {
+      success = write_map ();
+      if (success)
+        *sectorp = sector;
+      else
+        give_back (sector, cnt);
+    }
+  lock_release (&free_map_lock);
+  return success;
+}
+
+/* Allocates one sector from the free map, the first free one at
+   or after GOAL if there is one, and stores it into *SECTORP.
+   Returns true if successful, false if the disk is full or if
+   the free_map file could not be written. */
+bool
+free_map_allocate_near (block_sector_t goal, block_sector_t *sectorp)
+{
+  struct extent extent;
+
+  if (free_map_allocate_extents (goal, 1, &extent, 1) == 0)
+    return false;
+  *sectorp = extent.start;
+  return true;
+}
+
+/* Allocates up to CNT sectors from the free map, as up to
+   MAX_EXTENTS extents stored into EXTENTS, and returns the number
+   of extents.  The extents may add up to fewer than CNT sectors
+   if the disk is nearly full or so fragmented that MAX_EXTENTS
+   are not enough.
+
+   Prefers, in order: one extent of CNT sectors at or after GOAL;
+   the free extent that comes next after GOAL, however short;
+   and then the same from the start of the disk.  Each further
+   extent is sought after the one before it. */
+size_t
+free_map_allocate_extents (block_sector_t goal, size_t cnt,
+                           struct extent extents[], size_t max_extents)
+{
+  size_t extent_cnt = 0;
+  size_t total = 0;
+  size_t i;
+
+  lock_acquire (&free_map_lock);
+  while (total < cnt && extent_cnt < max_extents)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      size_t want = cnt - total;
+      block_sector_t start = find_run (goal, want);
+      size_t len = want;
+
+      if (start == BITMAP_ERROR)
+        {
+          /* No free extent is long enough.  Take the nearest one,
+             up to the next used sector. */
+          struct range_elem *next;
+
+          start = find_run (goal, 1);
+          if (start == BITMAP_ERROR)
+            break;
+          next = range_overlap (&used, start, bitmap_size (free_map));
+          len = (next != NULL ? next->start : bitmap_size (free_map)) - start;
+          if (len > want)
+            len = want;
+        }
+      if (!take (start, len))
+        break;
+
+      extents[extent_cnt].start = start;
+      extents[extent_cnt].cnt = len;
+      extent_cnt++;
+      total += len;
+      goal = start + len;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
-//printf("returning from free_map_allocate\n");
-  return sector != BITMAP_ERROR;
+
+  if (extent_cnt > 0 && !write_map ())
+    {
+      for (i = 0; i < extent_cnt; i++)
+        give_back (extents[i].start, extents[i].cnt);
+      extent_cnt = 0;
+    }
+  lock_release (&free_map_lock);
+  return extent_cnt;
 }
 
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
-  bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  give_back (sector, cnt);
+  write_map ();
+  lock_release (&free_map_lock);
 }
 
 /* Opens the free map file and reads it from disk. */
 void
-free_map_open (void) 
+free_map_open (void)
 {
   free_map_file = file_open (inode_open (FREE_MAP_SECTOR));
   if (free_map_file == NULL)
     PANIC ("can't open free map");
   if (!bitmap_read (free_map, free_map_file))
     PANIC ("can't read free map");
+  build_index ();
 }
 
 /* Writes the free map to disk and closes the free map file. */
 void
-free_map_close (void) 
+free_map_close (void)
 {
   file_close (free_map_file);
 }
@@ -72,10 +197,10 @@ free_map_close (void)
 /* Creates a new free map file on disk and writes the free map to
    it. */
 void
-free_map_create (void) 
+free_map_create (void)
 {
   /* Create inode. */
-  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map)))
+  if (!inode_create (FREE_MAP_SECTOR, bitmap_file_size (free_map), false))
     PANIC ("free map creation failed");
 
   /* Write bitmap to file. */
@@ -85,3 +210,140 @@ free_map_create (void)
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
 }
+
+/* Returns the first sector of the lowest run of CNT free sectors
+   at or after GOAL, or failing that at or after sector 0, or
+   BITMAP_ERROR if there is no such run.  Must be called with
+   `free_map_lock' held. */
+static block_sector_t
+find_run (block_sector_t goal, size_t cnt)
+{
+  size_t sector_cnt = bitmap_size (free_map);
+  uintptr_t start = RANGE_ERROR;
+
+  if (goal < sector_cnt)
+    start = range_find_gap (&used, goal, sector_cnt, cnt);
+  if (start == RANGE_ERROR)
+    start = range_find_gap (&used, 0, sector_cnt, cnt);
+  return start != RANGE_ERROR ? start : BITMAP_ERROR;
+}
+
+/* Marks the CNT free sectors starting at SECTOR as used, in the
+   bitmap and in the extent index, merging them with the used runs
+   on either side.  Returns true if successful, false if memory
+   is short, in which case nothing changes.  Must be called with
+   `free_map_lock' held. */
+static bool
+take (block_sector_t sector, size_t cnt)
+{
+  uintptr_t start = sector, end = sector + cnt;
+  struct range_elem *prev, *next;
+  struct used_extent *u = NULL;
+
+  prev = start > 0 ? range_find (&used, start - 1) : NULL;
+  next = range_find (&used, end);
+  if (prev == NULL && next == NULL)
+    {
+      u = kmem_cache_alloc (extent_cache);
+      if (u == NULL)
+        return false;
+    }
+
+  if (prev != NULL)
+    {
+      start = prev->start;
+      range_remove (&used, prev);
+      u = range_entry (prev, struct used_extent, elem);
+    }
+  if (next != NULL)
+    {
+      end = next->end;
+      range_remove (&used, next);
+      if (u == NULL)
+        u = range_entry (next, struct used_extent, elem);
+      else
+        kmem_cache_free (extent_cache,
+                         range_entry (next, struct used_extent, elem));
+    }
+  range_insert (&used, &u->elem, start, end);
+  bitmap_set_multiple (free_map, sector, cnt, true);
+  return true;
+}
+
+/* Marks the CNT used sectors starting at SECTOR as free, in the
+   bitmap and in the extent index.  If memory is too short to
+   split the used run that holds them, the index goes on treating
+   them as used, so they are not reused until the free map is next
+   read from disk.  Must be called with `free_map_lock' held. */
+static void
+give_back (block_sector_t sector, size_t cnt)
+{
+  struct range_elem *e = range_find (&used, sector);
+  uintptr_t start, end;
+  struct used_extent *u;
+
+  bitmap_set_multiple (free_map, sector, cnt, false);
+
+  ASSERT (e != NULL && e->end >= sector + cnt);
+  start = e->start;
+  end = e->end;
+  u = range_entry (e, struct used_extent, elem);
+
+  if (start < sector && end > sector + cnt)
+    {
+      /* Split the run in two. */
+      struct used_extent *upper = kmem_cache_alloc (extent_cache);
+      if (upper == NULL)
+        return;
+      range_remove (&used, e);
+      range_insert (&used, &u->elem, start, sector);
+      range_insert (&used, &upper->elem, sector + cnt, end);
+    }
+  else
+    {
+      range_remove (&used, e);
+      if (start < sector)
+        range_insert (&used, &u->elem, start, sector);
+      else if (end > sector + cnt)
+        range_insert (&used, &u->elem, sector + cnt, end);
+      else
+        kmem_cache_free (extent_cache, u);
+    }
+}
+
+/* Writes the bitmap to the free map file, if it is open.
+   Returns true if successful, false on failure. */
+static bool
+write_map (void)
+{
+  return free_map_file == NULL || bitmap_write (free_map, free_map_file);
+}
+
+/* Rebuilds the extent index from the bitmap. */
+static void
+build_index (void)
+{
+  size_t sector_cnt = bitmap_size (free_map);
+  size_t start = 0;
+
+  while (!range_empty (&used))
+    {
+      struct range_elem *e = range_first (&used);
+      range_remove (&used, e);
+      kmem_cache_free (extent_cache,
+                       range_entry (e, struct used_extent, elem));
+    }
+
+  while ((start = bitmap_scan (free_map, start, 1, true)) != BITMAP_ERROR)
+    {
+      size_t end = bitmap_scan (free_map, start, 1, false);
+      struct used_extent *u = kmem_cache_alloc (extent_cache);
+
+      if (u == NULL)
+        PANIC ("out of memory building free map index");
+      if (end == BITMAP_ERROR)
+        end = sector_cnt;
+      range_insert (&used, &u->elem, start, end);
+      start = end;
+    }
+}
@@ -5,6 +5,13 @@
 #include <stddef.h>
 #include "devices/block.h"
 
+/* A run of consecutive sectors. */
+struct extent
+  {
+    block_sector_t start;       /* First sector. */
+    size_t cnt;                 /* Number of sectors. */
+  };
+
 void free_map_init (void);
 void free_map_read (void);
 void free_map_create (void);
@@ -12,6 +19,9 @@ void free_map_open (void);
 void free_map_close (void);
 
 bool free_map_allocate (size_t, block_sector_t *);
+bool free_map_allocate_near (block_sector_t goal, block_sector_t *);
+size_t free_map_allocate_extents (block_sector_t goal, size_t cnt,
+                                  struct extent[], size_t max_extents);
 void free_map_release (block_sector_t, size_t);
 
 #endif /* filesys/free-map.h */
@@ -1,5 +1,6 @@
 #include "filesys/fsutil.h"
 #include <debug.h>
+#include <round.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -79,7 +80,7 @@ fsutil_extract (char **argv UNUSED)
 
   /* Allocate buffers. */
   header = malloc (BLOCK_SECTOR_SIZE);
-  data = malloc (BLOCK_SECTOR_SIZE);
+  data = palloc_get_page (0);
   if (header == NULL || data == NULL)
     PANIC ("couldn't allocate buffers");
 
@@ -124,13 +125,14 @@ fsutil_extract (char **argv UNUSED)
           if (dst == NULL)
             PANIC ("%s: open failed", file_name);
 
-          /* Do copy. */
+          /* Do copy, a page's worth of sectors at a time. */
           while (size > 0)
             {
-              int chunk_size = (size > BLOCK_SECTOR_SIZE
-                                ? BLOCK_SECTOR_SIZE
-                                : size);
-              block_read (src, sector++, data);
+              int chunk_size = size > PGSIZE ? PGSIZE : size;
+              size_t sector_cnt = DIV_ROUND_UP (chunk_size,
+                                                BLOCK_SECTOR_SIZE);
+              block_read_multi (src, sector, sector_cnt, data);
+              sector += sector_cnt;
               if (file_write (dst, data, chunk_size) != chunk_size)
                 PANIC ("%s: write failed with %d bytes unwritten",
                        file_name, size);
@@ -151,7 +153,7 @@ fsutil_extract (char **argv UNUSED)
   block_write (src, 0, header);
   block_write (src, 1, header);
 
-  free (data);
+  palloc_free_page (data);
   free (header);
 }
 
@@ -177,7 +179,7 @@ fsutil_append (char **argv)
   printf ("Appending '%s' to ustar archive on scratch device...\n", file_name);
 
   /* Allocate buffer. */
-  buffer = malloc (BLOCK_SECTOR_SIZE);
+  buffer = palloc_get_page (0);
   if (buffer == NULL)
     PANIC ("couldn't allocate buffer");
 
@@ -197,16 +199,19 @@ fsutil_append (char **argv)
     PANIC ("%s: name too long for ustar format", file_name);
   block_write (dst, sector++, buffer);
 
-  /* Do copy. */
+  /* Do copy, a page's worth of sectors at a time. */
   while (size > 0) 
     {
-      int chunk_size = size > BLOCK_SECTOR_SIZE ? BLOCK_SECTOR_SIZE : size;
-      if (sector >= block_size (dst))
+      int chunk_size = size > PGSIZE ? PGSIZE : size;
+      size_t sector_cnt = DIV_ROUND_UP (chunk_size, BLOCK_SECTOR_SIZE);
+      if (sector + sector_cnt > block_size (dst))
         PANIC ("%s: out of space on scratch device", file_name);
       if (file_read (src, buffer, chunk_size) != chunk_size)
         PANIC ("%s: read failed with %"PROTd" bytes unread", file_name, size);
-      memset (buffer + chunk_size, 0, BLOCK_SECTOR_SIZE - chunk_size);
-      block_write (dst, sector++, buffer);
+      memset (buffer + chunk_size, 0,
+              sector_cnt * BLOCK_SECTOR_SIZE - chunk_size);
+      block_write_multi (dst, sector, sector_cnt, buffer);
+      sector += sector_cnt;
       size -= chunk_size;
     }
 
@@ -219,5 +224,5 @@ fsutil_append (char **argv)
 
   /* Finish up. */
   file_close (src);
-  free (buffer);
+  palloc_free_page (buffer);
 }
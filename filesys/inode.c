@@ -1,23 +1,66 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
-#include "threads/malloc.h"
+#include "threads/slab.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of sector numbers in an inode and in an index block. */
+#define DIRECT_CNT 123
+#define PTRS_PER_SECTOR (BLOCK_SECTOR_SIZE / sizeof (block_sector_t))
+
+/* Flag in a data sector number: the sector has never been
+   written, so it reads as zeros whatever is on disk. */
+#define UNWRITTEN 0x80000000u
+
+/* Largest number of data sectors in a file. */
+#define MAX_SECTORS (DIRECT_CNT + PTRS_PER_SECTOR \
+                     + PTRS_PER_SECTOR * PTRS_PER_SECTOR)
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+
+   A file's data sectors are found through a multilevel index.
+   The first DIRECT_CNT are listed in `direct'.  The next
+   PTRS_PER_SECTOR are listed in the index block `indirect', and
+   the rest in the index blocks listed in the index block
+   `doubly_indirect'.  A sector number of 0 means that the sector
+   or index block has not been allocated; sector 0 holds the free
+   map's inode, so no file can own it.
+
+   Data sectors are not zeroed on disk when they are allocated.
+   Instead, the UNWRITTEN bit is set in the sector number that
+   lists them, until the first write to each one.  Reads of an
+   unwritten sector return zeros without touching the disk. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    block_sector_t direct[DIRECT_CNT];  /* Data sectors. */
+    block_sector_t indirect;            /* Index block of data sectors. */
+    block_sector_t doubly_indirect;     /* Index block of index blocks. */
+    uint32_t is_dir;                    /* Nonzero if a directory. */
+  };
+
+/* Number of extents that extend() asks the free map for at once. */
+#define POOL_EXTENTS 8
+
+/* Sectors allocated from the free map for extend() to hand out,
+   in order. */
+struct sector_pool
+  {
+    struct extent extents[POOL_EXTENTS]; /* Sectors not yet handed out. */
+    size_t extent_cnt;          /* Number of extents in `extents'. */
+    size_t next;                /* First extent not yet used up. */
+    size_t need;                /* Sectors still to be handed out. */
+    block_sector_t goal;        /* Where to allocate more. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -31,16 +74,25 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in `open_inodes'. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
     int deny_write_cnt;                 /* 0: writes ok, >0: deny writes. */
+    struct lock grow_lock;              /* Serializes growth. */
     struct inode_disk data;             /* Inode content. */
   };
 
+static block_sector_t lookup (const struct inode_disk *, size_t idx);
+static block_sector_t initialize (struct inode *, size_t idx, bool locked);
+static bool extend (struct inode_disk *, block_sector_t sector,
+                    off_t length);
+static void walk (const struct inode_disk *, void (*) (block_sector_t));
+static void release_sector (block_sector_t);
+static void sync_sector (block_sector_t);
+
 /* Returns the block device sector that contains byte offset POS
-   within INODE.
+   within INODE, with UNWRITTEN set if it has never been written.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
@@ -48,32 +100,47 @@ byte_to_sector (const struct inode *inode, off_t pos)
 {
   ASSERT (inode != NULL);
   if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
+    return lookup (&inode->data, pos / BLOCK_SECTOR_SIZE);
   else
     return -1;
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+/* Open inodes, by sector, so that opening a single inode twice
+   returns the same `struct inode'.  `open_inodes_lock' protects
+   the table and every open inode's `open_cnt'. */
+static struct hash open_inodes;
+static struct lock open_inodes_lock;
+
+static hash_hash_func inode_hash;
+static hash_less_func inode_less;
+static struct inode *find_open (block_sector_t);
+
+/* Cache of in-memory inodes. */
+static struct kmem_cache *inode_cache;
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  if (!hash_init (&open_inodes, inode_hash, inode_less, NULL))
+    PANIC ("could not create open inode table");
+  lock_init (&open_inodes_lock);
+  inode_cache = kmem_cache_create ("inode", sizeof (struct inode), NULL);
+  if (inode_cache == NULL)
+    PANIC ("could not create inode cache");
 }
 
 /* Initializes an inode with LENGTH bytes of data and
    writes the new inode to sector SECTOR on the file system
-   device.
+   device.  The inode is a directory's if IS_DIR is true.
    Returns true if successful.
    Returns false if memory or disk allocation fails. */
 bool
-inode_create (block_sector_t sector, off_t length)
+inode_create (block_sector_t sector, off_t length, bool is_dir)
 {
-  struct inode_disk *disk_inode = NULL;
-  bool success = false;
+  struct cache_entry *e;
+  struct inode_disk *disk_inode;
+  bool success;
 
   ASSERT (length >= 0);
 
@@ -81,27 +148,19 @@ inode_create (block_sector_t sector, off_t length)
      one sector in size, and you should fix that. */
   ASSERT (sizeof *disk_inode == BLOCK_SECTOR_SIZE);
 
-  disk_inode = calloc (1, sizeof *disk_inode);
-  if (disk_inode != NULL)
-    {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
-      disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
-        {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
-          success = true; 
-        } 
-      free (disk_inode);
-    }
+  /* Build the inode right in the cache. */
+  e = cache_pin (sector, false);
+  disk_inode = cache_data (e);
+  memset (disk_inode, 0, sizeof *disk_inode);
+  disk_inode->magic = INODE_MAGIC;
+  disk_inode->is_dir = is_dir;
+  success = extend (disk_inode, sector, length);
+  if (success)
+    disk_inode->length = length;
+  else
+    walk (disk_inode, release_sector);
+  cache_mark_dirty (e);
+  cache_unpin (e);
   return success;
 }
 
@@ -111,33 +170,45 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
-  struct inode *inode;
+  struct inode *inode, *open;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
-    {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
-    }
+  lock_acquire (&open_inodes_lock);
+  open = find_open (sector);
+  if (open != NULL)
+    open->open_cnt++;
+  lock_release (&open_inodes_lock);
+  if (open != NULL)
+    return open;
 
   /* Allocate memory. */
-  inode = malloc (sizeof *inode);
+  inode = kmem_cache_alloc (inode_cache);
   if (inode == NULL)
     return NULL;
 
-  /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
+  /* Initialize, without holding the lock across the read. */
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  lock_init (&inode->grow_lock);
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+
+  /* Publish INODE, unless another thread opened the same inode
+     while we were reading it. */
+  lock_acquire (&open_inodes_lock);
+  open = find_open (sector);
+  if (open != NULL)
+    open->open_cnt++;
+  else
+    hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  if (open != NULL)
+    {
+      kmem_cache_free (inode_cache, inode);
+      return open;
+    }
   return inode;
 }
 
@@ -146,7 +217,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -163,25 +238,31 @@ inode_get_inumber (const struct inode *inode)
 void
 inode_close (struct inode *inode) 
 {
+  bool last;
+
   /* Ignore null pointer. */
   if (inode == NULL)
     return;
 
+  /* Remove from the open inode table if this was the last
+     opener. */
+  lock_acquire (&open_inodes_lock);
+  last = --inode->open_cnt == 0;
+  if (last)
+    hash_delete (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  if (last)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
- 
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          walk (&inode->data, release_sector);
         }
 
-      free (inode); 
+      kmem_cache_free (inode_cache, inode);
     }
 }
 
@@ -202,7 +283,6 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
   while (size > 0) 
     {
@@ -220,59 +300,65 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      if (sector_idx & UNWRITTEN)
+        memset (buffer + bytes_read, 0, chunk_size);
+      else
+        cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
 
   return bytes_read;
 }
 
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs.
+   A write past end of file extends the inode, filling any gap
+   with zeros.  The new length only becomes visible to readers
+   once the data has been written. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
+  off_t end = offset + size;
+  bool grow;
 
-  if (inode->deny_write_cnt)
+  if (inode->deny_write_cnt || size <= 0)
     return 0;
 
+  /* Allocate the sectors past end of file, without publishing the
+     new length yet. */
+  grow = end > inode_length (inode);
+  if (grow)
+    {
+      lock_acquire (&inode->grow_lock);
+      grow = end > inode_length (inode);
+      if (grow && !extend (&inode->data, inode->sector, end))
+        {
+          /* Keep track of whatever was allocated. */
+          cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+          lock_release (&inode->grow_lock);
+          return 0;
+        }
+      if (!grow)
+        lock_release (&inode->grow_lock);
+    }
+
   while (size > 0) 
     {
       /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      size_t idx = offset / BLOCK_SECTOR_SIZE;
+      block_sector_t sector_idx = lookup (&inode->data, idx);
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
-      off_t inode_left = inode_length (inode) - offset;
+      off_t inode_left = end - offset;
       int sector_left = BLOCK_SECTOR_SIZE - sector_ofs;
       int min_left = inode_left < sector_left ? inode_left : sector_left;
 
@@ -281,42 +367,57 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
-        }
-      else 
-        {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
+      if (sector_idx & UNWRITTEN)
+        sector_idx = initialize (inode, idx, grow);
 
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
-        }
+      /* The cache reads the sector in first only if the chunk
+         does not cover all of it. */
+      cache_write (sector_idx, buffer + bytes_written, sector_ofs,
+                   chunk_size);
 
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
+  if (grow)
+    {
+      inode->data.length = end;
+      cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+      lock_release (&inode->grow_lock);
+    }
   return bytes_written;
 }
 
+/* Asks for the sectors of INODE that hold bytes START through
+   END - 1 to be read into the buffer cache in the background.
+   Bytes past the end of INODE are ignored. */
+void
+inode_read_ahead (struct inode *inode, off_t start, off_t end)
+{
+  off_t ofs;
+
+  if (end > inode_length (inode))
+    end = inode_length (inode);
+  for (ofs = start - start % BLOCK_SECTOR_SIZE; ofs < end;
+       ofs += BLOCK_SECTOR_SIZE)
+    {
+      block_sector_t sector = byte_to_sector (inode, ofs);
+      if (!(sector & UNWRITTEN))
+        cache_read_ahead (sector);
+    }
+}
+
+/* Writes INODE and any of its data that is only in the buffer
+   cache to disk. */
+void
+inode_sync (struct inode *inode)
+{
+  walk (&inode->data, sync_sector);
+  cache_flush_sector (inode->sector);
+}
+
 /* Disables writes to INODE.
    May be called at most once per inode opener. */
 void
@@ -343,3 +444,374 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Returns true if INODE is a directory's. */
+bool
+inode_is_dir (const struct inode *inode)
+{
+  return inode->data.is_dir != 0;
+}
+
+/* Returns the number of openers of INODE. */
+int
+inode_open_cnt (const struct inode *inode)
+{
+  return inode->open_cnt;
+}
+
+/* Returns the sector number stored in entry IDX of index block
+   SECTOR. */
+static block_sector_t
+index_get (block_sector_t sector, size_t idx)
+{
+  block_sector_t entry;
+
+  cache_read (sector, &entry, idx * sizeof entry, sizeof entry);
+  return entry;
+}
+
+/* Returns the sector that holds data sector IDX of the file
+   described by DISK_INODE, with UNWRITTEN set if it has never
+   been written, or 0 if it has not been allocated. */
+static block_sector_t
+lookup (const struct inode_disk *disk_inode, size_t idx)
+{
+  block_sector_t block;
+
+  if (idx < DIRECT_CNT)
+    return disk_inode->direct[idx];
+  idx -= DIRECT_CNT;
+
+  if (idx < PTRS_PER_SECTOR)
+    {
+      block = disk_inode->indirect;
+      return block != 0 ? index_get (block, idx) : 0;
+    }
+  idx -= PTRS_PER_SECTOR;
+
+  ASSERT (idx < PTRS_PER_SECTOR * PTRS_PER_SECTOR);
+  block = disk_inode->doubly_indirect;
+  if (block != 0)
+    block = index_get (block, idx / PTRS_PER_SECTOR);
+  return block != 0 ? index_get (block, idx % PTRS_PER_SECTOR) : 0;
+}
+
+/* Stores ENTRY as the sector number in entry IDX of index block
+   SECTOR. */
+static void
+index_set (block_sector_t sector, size_t idx, block_sector_t entry)
+{
+  cache_write (sector, &entry, idx * sizeof entry, sizeof entry);
+}
+
+/* Readies unwritten data sector IDX of INODE for its first
+   write: zeros it in the buffer cache, without reading it from
+   disk, and then clears its UNWRITTEN flag.  Returns the sector.
+   LOCKED says whether the caller already holds INODE's
+   `grow_lock', which serializes this against other writers. */
+static block_sector_t
+initialize (struct inode *inode, size_t idx, bool locked)
+{
+  struct inode_disk *disk_inode = &inode->data;
+  block_sector_t sector;
+
+  if (!locked)
+    lock_acquire (&inode->grow_lock);
+
+  /* Another writer may have got here first. */
+  sector = lookup (disk_inode, idx);
+  if (sector & UNWRITTEN)
+    {
+      struct cache_entry *e;
+      block_sector_t block;
+
+      sector &= ~UNWRITTEN;
+      e = cache_pin (sector, false);
+      memset (cache_data (e), 0, BLOCK_SECTOR_SIZE);
+      cache_mark_dirty (e);
+      cache_unpin (e);
+
+      if (idx < DIRECT_CNT)
+        {
+          disk_inode->direct[idx] = sector;
+          cache_write (inode->sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
+        }
+      else
+        {
+          idx -= DIRECT_CNT;
+          if (idx < PTRS_PER_SECTOR)
+            block = disk_inode->indirect;
+          else
+            {
+              idx -= PTRS_PER_SECTOR;
+              block = index_get (disk_inode->doubly_indirect,
+                                 idx / PTRS_PER_SECTOR);
+              idx %= PTRS_PER_SECTOR;
+            }
+          index_set (block, idx, sector);
+        }
+    }
+
+  if (!locked)
+    lock_release (&inode->grow_lock);
+  return sector;
+}
+
+/* Returns the number of index blocks that a file with SECTORS
+   data sectors needs. */
+static size_t
+index_block_cnt (size_t sectors)
+{
+  size_t cnt = 0;
+
+  if (sectors > DIRECT_CNT)
+    cnt++;
+  if (sectors > DIRECT_CNT + PTRS_PER_SECTOR)
+    cnt += 1 + DIV_ROUND_UP (sectors - DIRECT_CNT - PTRS_PER_SECTOR,
+                             PTRS_PER_SECTOR);
+  return cnt;
+}
+
+/* Takes a sector from POOL, refilling it from the free map if it
+   is empty.  Returns the sector, or 0 if the disk is full. */
+static block_sector_t
+pool_take (struct sector_pool *pool)
+{
+  struct extent *e;
+  block_sector_t sector;
+
+  if (pool->next == pool->extent_cnt)
+    {
+      pool->extent_cnt = free_map_allocate_extents (
+        pool->goal, pool->need > 0 ? pool->need : 1,
+        pool->extents, POOL_EXTENTS);
+      pool->next = 0;
+      if (pool->extent_cnt == 0)
+        return 0;
+    }
+
+  e = &pool->extents[pool->next];
+  sector = e->start++;
+  if (--e->cnt == 0)
+    pool->next++;
+  if (pool->need > 0)
+    pool->need--;
+  pool->goal = sector + 1;
+  return sector;
+}
+
+/* Returns the sectors left in POOL to the free map. */
+static void
+pool_release (struct sector_pool *pool)
+{
+  for (; pool->next < pool->extent_cnt; pool->next++)
+    {
+      struct extent *e = &pool->extents[pool->next];
+      if (e->cnt > 0)
+        free_map_release (e->start, e->cnt);
+    }
+}
+
+/* Ensures that *SLOT names an allocated sector, taking one from
+   POOL if it is 0.  A new data sector (if DATA is true) is only
+   marked UNWRITTEN; a new index block is zeroed in the buffer
+   cache.  Returns the sector, without the UNWRITTEN flag, or 0 on
+   failure.  Sets *DIRTY to true if *SLOT changes. */
+static block_sector_t
+allocate (block_sector_t *slot, bool data, struct sector_pool *pool,
+          bool *dirty)
+{
+  if (*slot == 0)
+    {
+      block_sector_t sector = pool_take (pool);
+
+      if (sector == 0)
+        return 0;
+      *dirty = true;
+      if (data)
+        *slot = sector | UNWRITTEN;
+      else
+        {
+          struct cache_entry *e = cache_pin (sector, false);
+          memset (cache_data (e), 0, BLOCK_SECTOR_SIZE);
+          cache_mark_dirty (e);
+          cache_unpin (e);
+          *slot = sector;
+        }
+    }
+  return *slot & ~UNWRITTEN;
+}
+
+/* Ensures that entry IDX of index block SECTOR names an
+   allocated sector, as allocate() does, and returns it, or 0 on
+   failure. */
+static block_sector_t
+index_allocate (block_sector_t sector, size_t idx, bool data,
+                struct sector_pool *pool)
+{
+  struct cache_entry *e = cache_pin (sector, true);
+  block_sector_t *entries = cache_data (e);
+  bool dirty = false;
+  block_sector_t result = allocate (&entries[idx], data, pool, &dirty);
+
+  if (dirty)
+    cache_mark_dirty (e);
+  cache_unpin (e);
+  return result;
+}
+
+/* Allocates every data sector, and every index block, that the
+   file described by DISK_INODE, whose inode is in SECTOR, needs
+   to be LENGTH bytes long.  Sectors that are already allocated
+   are left alone.  Does not change the file's length.
+
+   The new sectors are allocated from the free map together, as
+   few extents as possible, starting just past the file's last
+   data sector, or just past the inode for an empty file, so that
+   the file stays together on disk.
+
+   New data sectors read as zeros but are not written, so the
+   cost does not depend on how many there are.
+
+   Returns true if successful, false if the file would be too
+   long or the disk is full; some sectors may have been allocated
+   even then. */
+static bool
+extend (struct inode_disk *disk_inode, block_sector_t sector, off_t length)
+{
+  size_t old_sectors = bytes_to_sectors (disk_inode->length);
+  size_t sectors = bytes_to_sectors (length);
+  struct sector_pool pool;
+  bool dirty = false;
+  bool success = true;
+  size_t i;
+
+  if (sectors > MAX_SECTORS)
+    return false;
+  if (sectors <= old_sectors)
+    return true;
+
+  pool.extent_cnt = pool.next = 0;
+  pool.need = (sectors + index_block_cnt (sectors)
+               - old_sectors - index_block_cnt (old_sectors));
+  pool.goal = (old_sectors > 0
+               ? lookup (disk_inode, old_sectors - 1) & ~UNWRITTEN : 0);
+  pool.goal = (pool.goal != 0 ? pool.goal : sector) + 1;
+
+  for (i = old_sectors; success && i < sectors; i++)
+    {
+      size_t idx = i;
+      block_sector_t block;
+
+      if (idx < DIRECT_CNT)
+        {
+          success = allocate (&disk_inode->direct[idx], true,
+                              &pool, &dirty) != 0;
+          continue;
+        }
+      idx -= DIRECT_CNT;
+
+      if (idx < PTRS_PER_SECTOR)
+        block = allocate (&disk_inode->indirect, false, &pool, &dirty);
+      else
+        {
+          idx -= PTRS_PER_SECTOR;
+          block = allocate (&disk_inode->doubly_indirect, false,
+                            &pool, &dirty);
+          if (block != 0)
+            block = index_allocate (block, idx / PTRS_PER_SECTOR, false,
+                                    &pool);
+          idx %= PTRS_PER_SECTOR;
+        }
+      success = block != 0 && index_allocate (block, idx, true, &pool) != 0;
+    }
+
+  /* Sectors left over, because an earlier failed extension had
+     already allocated some of them, go back to the free map. */
+  pool_release (&pool);
+  return success;
+}
+
+/* Calls FUNC on each sector listed in index block SECTOR and
+   then on SECTOR itself.  If LEVEL is nonzero, the listed sectors
+   are themselves index blocks with LEVEL - 1 further levels of
+   index below them, and are walked the same way. */
+static void
+walk_index (block_sector_t sector, size_t level,
+            void (*func) (block_sector_t))
+{
+  size_t i;
+
+  for (i = 0; i < PTRS_PER_SECTOR; i++)
+    {
+      block_sector_t entry = index_get (sector, i);
+      if (entry == 0)
+        continue;
+      if (level > 0)
+        walk_index (entry, level - 1, func);
+      else
+        func (entry & ~UNWRITTEN);
+    }
+  func (sector);
+}
+
+/* Calls FUNC on every allocated sector of the file described by
+   DISK_INODE, data sectors and index blocks alike, but not on
+   the inode's own sector.  Each index block is passed to FUNC
+   after the sectors it lists, so FUNC may free them. */
+static void
+walk (const struct inode_disk *disk_inode, void (*func) (block_sector_t))
+{
+  size_t i;
+
+  for (i = 0; i < DIRECT_CNT; i++)
+    if (disk_inode->direct[i] != 0)
+      func (disk_inode->direct[i] & ~UNWRITTEN);
+  if (disk_inode->indirect != 0)
+    walk_index (disk_inode->indirect, 0, func);
+  if (disk_inode->doubly_indirect != 0)
+    walk_index (disk_inode->doubly_indirect, 1, func);
+}
+
+/* Returns SECTOR to the free map. */
+static void
+release_sector (block_sector_t sector)
+{
+  free_map_release (sector, 1);
+}
+
+/* Writes SECTOR to disk if it is dirty in the buffer cache. */
+static void
+sync_sector (block_sector_t sector)
+{
+  cache_flush_sector (sector);
+}
+
+/* Returns the open inode for SECTOR, or a null pointer if it is
+   not open.  Must be called with `open_inodes_lock' held. */
+static struct inode *
+find_open (block_sector_t sector)
+{
+  struct inode key;
+  struct hash_elem *e;
+
+  key.sector = sector;
+  e = hash_find (&open_inodes, &key.elem);
+  return e != NULL ? hash_entry (e, struct inode, elem) : NULL;
+}
+
+/* Returns a hash of inode E's sector. */
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
+}
+
+/* Returns true if inode A's sector precedes inode B's. */
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
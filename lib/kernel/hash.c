@@ -17,7 +17,12 @@ static struct hash_elem *find_elem (struct hash *, struct list *,
                                     struct hash_elem *);
 static void insert_elem (struct hash *, struct list *, struct hash_elem *);
 static void remove_elem (struct hash *, struct hash_elem *);
+static void clear_buckets (struct hash *, struct list *, size_t cnt,
+                           hash_action_func *);
+static struct list *first_bucket (struct hash *);
+static struct list *next_bucket (struct hash *, struct list *);
 static void rehash (struct hash *);
+static void migrate (struct hash *);
 
 /* Initializes hash table H to compute hash values using HASH and
    compare hash elements using LESS, given auxiliary data AUX. */
@@ -28,6 +33,9 @@ hash_init (struct hash *h,
   h->elem_cnt = 0;
   h->bucket_cnt = 4;
   h->buckets = malloc (sizeof *h->buckets * h->bucket_cnt);
+  h->old_bucket_cnt = 0;
+  h->old_buckets = NULL;
+  h->migrate_idx = 0;
   h->hash = hash;
   h->less = less;
   h->aux = aux;
@@ -53,22 +61,16 @@ hash_init (struct hash *h,
 void
 hash_clear (struct hash *h, hash_action_func *destructor) 
 {
-  size_t i;
-
-  for (i = 0; i < h->bucket_cnt; i++) 
+  if (h->old_buckets != NULL)
     {
-      struct list *bucket = &h->buckets[i];
-
-      if (destructor != NULL) 
-        while (!list_empty (bucket)) 
-          {
-            struct list_elem *list_elem = list_pop_front (bucket);
-            struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
-            destructor (hash_elem, h->aux);
-          }
-
-      list_init (bucket); 
-    }    
+      clear_buckets (h, h->old_buckets + h->migrate_idx,
+                     h->old_bucket_cnt - h->migrate_idx, destructor);
+      free (h->old_buckets);
+      h->old_buckets = NULL;
+      h->old_bucket_cnt = 0;
+      h->migrate_idx = 0;
+    }
+  clear_buckets (h, h->buckets, h->bucket_cnt, destructor);
 
   h->elem_cnt = 0;
 }
@@ -88,6 +90,7 @@ hash_destroy (struct hash *h, hash_action_func *destructor)
 {
   if (destructor != NULL)
     hash_clear (h, destructor);
+  free (h->old_buckets);
   free (h->buckets);
 }
 
@@ -162,13 +165,13 @@ hash_delete (struct hash *h, struct hash_elem *e)
 void
 hash_apply (struct hash *h, hash_action_func *action) 
 {
-  size_t i;
+  struct list *bucket;
   
   ASSERT (action != NULL);
 
-  for (i = 0; i < h->bucket_cnt; i++) 
+  for (bucket = first_bucket (h); bucket != NULL;
+       bucket = next_bucket (h, bucket)) 
     {
-      struct list *bucket = &h->buckets[i];
       struct list_elem *elem, *next;
 
       for (elem = list_begin (bucket); elem != list_end (bucket); elem = next) 
@@ -203,7 +206,7 @@ hash_first (struct hash_iterator *i, struct hash *h)
   ASSERT (h != NULL);
 
   i->hash = h;
-  i->bucket = i->hash->buckets;
+  i->bucket = first_bucket (h);
   i->elem = list_elem_to_hash_elem (list_head (i->bucket));
 }
 
@@ -223,7 +226,8 @@ hash_next (struct hash_iterator *i)
   i->elem = list_elem_to_hash_elem (list_next (&i->elem->list_elem));
   while (i->elem == list_elem_to_hash_elem (list_end (i->bucket)))
     {
-      if (++i->bucket >= i->hash->buckets + i->hash->bucket_cnt)
+      i->bucket = next_bucket (i->hash, i->bucket);
+      if (i->bucket == NULL)
         {
           i->elem = NULL;
           break;
@@ -257,6 +261,31 @@ hash_empty (struct hash *h)
   return h->elem_cnt == 0;
 }
 
+/* Fills in STATS with the occupancy of H's buckets.  Takes time
+   proportional to the number of buckets.  The average chain
+   length is STATS->elem_cnt / STATS->used_bucket_cnt. */
+void
+hash_stats (struct hash *h, struct hash_stats *stats) 
+{
+  struct list *bucket;
+
+  stats->elem_cnt = h->elem_cnt;
+  stats->bucket_cnt = h->bucket_cnt + h->old_bucket_cnt;
+  stats->used_bucket_cnt = 0;
+  stats->longest_chain = 0;
+  stats->resizing = h->old_buckets != NULL;
+
+  for (bucket = first_bucket (h); bucket != NULL;
+       bucket = next_bucket (h, bucket))
+    {
+      size_t len = list_size (bucket);
+      if (len > 0)
+        stats->used_bucket_cnt++;
+      if (len > stats->longest_chain)
+        stats->longest_chain = len;
+    }
+}
+
 /* Fowler-Noll-Vo hash constants, for 32-bit word sizes. */
 #define FNV_32_PRIME 16777619u
 #define FNV_32_BASIS 2166136261u
@@ -301,12 +330,44 @@ hash_int (int i)
   return hash_bytes (&i, sizeof i);
 }
 
-/* Returns the bucket in H that E belongs in. */
+/* Returns the bucket in H that E belongs in.  While H is being
+   resized, that is its old bucket if that has not been migrated
+   yet, otherwise its new one. */
 static struct list *
 find_bucket (struct hash *h, struct hash_elem *e) 
 {
-  size_t bucket_idx = h->hash (e, h->aux) & (h->bucket_cnt - 1);
-  return &h->buckets[bucket_idx];
+  unsigned hash = h->hash (e, h->aux);
+
+  if (h->old_buckets != NULL)
+    {
+      size_t old_idx = hash & (h->old_bucket_cnt - 1);
+      if (old_idx >= h->migrate_idx)
+        return &h->old_buckets[old_idx];
+    }
+  return &h->buckets[hash & (h->bucket_cnt - 1)];
+}
+
+/* Returns the first bucket of H to iterate over. */
+static struct list *
+first_bucket (struct hash *h) 
+{
+  return (h->old_buckets != NULL
+          ? h->old_buckets + h->migrate_idx
+          : h->buckets);
+}
+
+/* Returns the bucket of H after BUCKET in iteration order, which
+   visits the unmigrated old buckets and then the current ones.
+   Returns a null pointer after the last bucket. */
+static struct list *
+next_bucket (struct hash *h, struct list *bucket) 
+{
+  if (h->old_buckets != NULL
+      && bucket >= h->old_buckets
+      && bucket < h->old_buckets + h->old_bucket_cnt)
+    return (++bucket < h->old_buckets + h->old_bucket_cnt
+            ? bucket : h->buckets);
+  return ++bucket < h->buckets + h->bucket_cnt ? bucket : NULL;
 }
 
 /* Searches BUCKET in H for a hash element equal to E.  Returns
@@ -344,21 +405,32 @@ is_power_of_2 (size_t x)
 #define BEST_ELEMS_PER_BUCKET 2 /* Ideal elems/bucket. */
 #define MAX_ELEMS_PER_BUCKET  4 /* Elems/bucket > 4: increase # of buckets. */
 
-/* Changes the number of buckets in hash table H to match the
-   ideal.  This function can fail because of an out-of-memory
-   condition, but that'll just make hash accesses less efficient;
-   we can still continue. */
+/* Migration work per resize step: old buckets with elements to
+   move, and old buckets looked at in all. */
+#define MIGRATE_BUCKETS 2
+#define MIGRATE_VISITS  8
+
+/* Continues resizing H, if a resize is in progress, or else
+   starts changing the number of buckets in H to match the ideal.
+   Starting can fail because of an out-of-memory condition, but
+   that'll just make hash accesses less efficient; we can still
+   continue. */
 static void
 rehash (struct hash *h) 
 {
   size_t old_bucket_cnt, new_bucket_cnt;
-  struct list *new_buckets, *old_buckets;
+  struct list *new_buckets;
   size_t i;
 
   ASSERT (h != NULL);
 
+  if (h->old_buckets != NULL)
+    {
+      migrate (h);
+      return;
+    }
+
   /* Save old bucket info for later use. */
-  old_buckets = h->buckets;
   old_bucket_cnt = h->bucket_cnt;
 
   /* Calculate the number of buckets to use now.
@@ -387,29 +459,47 @@ rehash (struct hash *h)
   for (i = 0; i < new_bucket_cnt; i++) 
     list_init (&new_buckets[i]);
 
-  /* Install new bucket info. */
+  /* Install new bucket info, keeping the old buckets until their
+     elements have all been moved. */
+  h->old_buckets = h->buckets;
+  h->old_bucket_cnt = old_bucket_cnt;
+  h->migrate_idx = 0;
   h->buckets = new_buckets;
   h->bucket_cnt = new_bucket_cnt;
 
-  /* Move each old element into the appropriate new bucket. */
-  for (i = 0; i < old_bucket_cnt; i++) 
+  migrate (h);
+}
+
+/* Moves the elements of a few of H's old buckets into the new
+   ones, and frees the old buckets once they are all empty. */
+static void
+migrate (struct hash *h) 
+{
+  size_t moved = 0, visited = 0;
+
+  while (h->migrate_idx < h->old_bucket_cnt
+         && moved < MIGRATE_BUCKETS && visited < MIGRATE_VISITS)
     {
-      struct list *old_bucket;
-      struct list_elem *elem, *next;
+      struct list *old_bucket = &h->old_buckets[h->migrate_idx++];
 
-      old_bucket = &old_buckets[i];
-      for (elem = list_begin (old_bucket);
-           elem != list_end (old_bucket); elem = next) 
+      visited++;
+      if (!list_empty (old_bucket))
+        moved++;
+      while (!list_empty (old_bucket)) 
         {
-          struct list *new_bucket
-            = find_bucket (h, list_elem_to_hash_elem (elem));
-          next = list_next (elem);
-          list_remove (elem);
-          list_push_front (new_bucket, elem);
+          struct list_elem *elem = list_pop_front (old_bucket);
+          unsigned hash = h->hash (list_elem_to_hash_elem (elem), h->aux);
+          list_push_front (&h->buckets[hash & (h->bucket_cnt - 1)], elem);
         }
     }
 
-  free (old_buckets);
+  if (h->migrate_idx >= h->old_bucket_cnt)
+    {
+      free (h->old_buckets);
+      h->old_buckets = NULL;
+      h->old_bucket_cnt = 0;
+      h->migrate_idx = 0;
+    }
 }
 
 /* Inserts E into BUCKET (in hash table H). */
@@ -428,3 +518,27 @@ remove_elem (struct hash *h, struct hash_elem *e)
   list_remove (&e->list_elem);
 }
 
+/* Empties the CNT buckets starting at BUCKETS in hash table H,
+   calling DESTRUCTOR, if non-null, on each element. */
+static void
+clear_buckets (struct hash *h, struct list *buckets, size_t cnt,
+               hash_action_func *destructor) 
+{
+  size_t i;
+
+  for (i = 0; i < cnt; i++) 
+    {
+      struct list *bucket = &buckets[i];
+
+      if (destructor != NULL) 
+        while (!list_empty (bucket)) 
+          {
+            struct list_elem *list_elem = list_pop_front (bucket);
+            struct hash_elem *hash_elem = list_elem_to_hash_elem (list_elem);
+            destructor (hash_elem, h->aux);
+          }
+
+      list_init (bucket); 
+    }    
+}
+
@@ -18,7 +18,14 @@
    conversion from a struct hash_elem back to a structure object
    that contains it.  This is the same technique used in the
    linked list implementation.  Refer to lib/kernel/list.h for a
-   detailed explanation. */
+   detailed explanation.
+
+   The table grows and shrinks incrementally.  Resizing allocates
+   the new bucket array but leaves the elements where they are;
+   each later insertion, replacement or deletion then moves the
+   contents of a few old buckets across, until the old array is
+   empty and can be freed.  No single operation ever has to move
+   the whole table. */
 
 #include <stdbool.h>
 #include <stddef.h>
@@ -61,11 +68,24 @@ struct hash
     size_t elem_cnt;            /* Number of elements in table. */
     size_t bucket_cnt;          /* Number of buckets, a power of 2. */
     struct list *buckets;       /* Array of `bucket_cnt' lists. */
+    size_t old_bucket_cnt;      /* Number of old buckets, while resizing. */
+    struct list *old_buckets;   /* Buckets being emptied, or null. */
+    size_t migrate_idx;         /* Old buckets below this are empty. */
     hash_hash_func *hash;       /* Hash function. */
     hash_less_func *less;       /* Comparison function. */
     void *aux;                  /* Auxiliary data for `hash' and `less'. */
   };
 
+/* Hash table occupancy, as reported by hash_stats(). */
+struct hash_stats
+  {
+    size_t elem_cnt;            /* Number of elements. */
+    size_t bucket_cnt;          /* Buckets, old and new. */
+    size_t used_bucket_cnt;     /* Buckets with at least one element. */
+    size_t longest_chain;       /* Elements in the fullest bucket. */
+    bool resizing;              /* Is a resize in progress? */
+  };
+
 /* A hash table iterator. */
 struct hash_iterator 
   {
@@ -94,6 +114,7 @@ struct hash_elem *hash_cur (struct hash_iterator *);
 /* Information. */
 size_t hash_size (struct hash *);
 bool hash_empty (struct hash *);
+void hash_stats (struct hash *, struct hash_stats *);
 
 /* Sample hash functions. */
 unsigned hash_bytes (const void *, size_t);
@@ -0,0 +1,218 @@
+#include "heap.h"
+#include "../debug.h"
+
+/* A pairing heap is a single tree.  Each node points to its
+   first child, and the children of a node form a doubly linked
+   list through `next' and `prev', except that the first child's
+   `prev' points to the parent instead.  The root's `prev' and
+   `next' are null.
+
+   Two trees are combined by "linking" them: the root with the
+   greater value becomes the first child of the other root.
+   Pushing an element links it with the root as a one-node tree.
+   Popping the root leaves a list of subtrees, which are linked
+   in pairs from left to right, and then the pairs are linked
+   into one tree from right to left.  This two-pass pairing is
+   what gives the heap its O(lg n) amortized bound.
+
+   The pairing passes are iterative, not recursive, because a
+   kernel thread's stack is small and a heap's root may have
+   thousands of children. */
+
+static struct heap_elem *link (struct heap *,
+                               struct heap_elem *, struct heap_elem *);
+static struct heap_elem *merge_pairs (struct heap *, struct heap_elem *);
+static void detach (struct heap_elem *);
+
+/* Initializes heap H as an empty heap ordered by LESS, given
+   auxiliary data AUX. */
+void
+heap_init (struct heap *h, heap_less_func *less, void *aux)
+{
+  ASSERT (h != NULL);
+  ASSERT (less != NULL);
+
+  h->root = NULL;
+  h->elem_cnt = 0;
+  h->less = less;
+  h->aux = aux;
+}
+
+/* Inserts E into heap H.  E must not already be in a heap. */
+void
+heap_push (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  e->child = e->next = e->prev = NULL;
+  h->root = h->root != NULL ? link (h, h->root, e) : e;
+  h->elem_cnt++;
+}
+
+/* Returns the least element in H, or a null pointer if H is
+   empty.  If several elements are least, returns one of them. */
+struct heap_elem *
+heap_min (const struct heap *h)
+{
+  ASSERT (h != NULL);
+
+  return h->root;
+}
+
+/* Removes and returns the least element in H, or returns a null
+   pointer if H is empty. */
+struct heap_elem *
+heap_pop_min (struct heap *h)
+{
+  struct heap_elem *min;
+
+  ASSERT (h != NULL);
+
+  min = h->root;
+  if (min != NULL)
+    {
+      h->root = merge_pairs (h, min->child);
+      h->elem_cnt--;
+      min->child = NULL;
+    }
+  return min;
+}
+
+/* Restores heap order after the value of E, an element of H, has
+   been lowered. */
+void
+heap_decrease (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  if (e != h->root)
+    {
+      /* E's subtree is still in order, so cut it out and link it
+         back in at the top. */
+      detach (e);
+      h->root = link (h, h->root, e);
+    }
+}
+
+/* Removes E, which must be an element of H, from H. */
+void
+heap_remove (struct heap *h, struct heap_elem *e)
+{
+  ASSERT (h != NULL);
+  ASSERT (e != NULL);
+
+  if (e == h->root)
+    heap_pop_min (h);
+  else
+    {
+      struct heap_elem *sub;
+
+      detach (e);
+      sub = merge_pairs (h, e->child);
+      if (sub != NULL)
+        h->root = link (h, h->root, sub);
+      h->elem_cnt--;
+      e->child = NULL;
+    }
+}
+
+/* Returns the number of elements in H. */
+size_t
+heap_size (const struct heap *h)
+{
+  ASSERT (h != NULL);
+
+  return h->elem_cnt;
+}
+
+/* Returns true if H is empty, false otherwise. */
+bool
+heap_empty (const struct heap *h)
+{
+  ASSERT (h != NULL);
+
+  return h->root == NULL;
+}
+
+/* Links the trees rooted at A and B, which must not be children
+   of any node, and returns the root of the combined tree.  The
+   returned root's `next' and `prev' are null. */
+static struct heap_elem *
+link (struct heap *h, struct heap_elem *a, struct heap_elem *b)
+{
+  if (h->less (b, a, h->aux))
+    {
+      struct heap_elem *tmp = a;
+      a = b;
+      b = tmp;
+    }
+
+  /* Make B the first child of A. */
+  b->next = a->child;
+  if (b->next != NULL)
+    b->next->prev = b;
+  b->prev = a;
+  a->child = b;
+
+  a->next = a->prev = NULL;
+  return a;
+}
+
+/* Links FIRST and its siblings, which are the children of a
+   removed node, into a single tree using the two-pass pairing
+   method, and returns its root, or a null pointer if FIRST is
+   null. */
+static struct heap_elem *
+merge_pairs (struct heap *h, struct heap_elem *first)
+{
+  struct heap_elem *pairs = NULL;
+  struct heap_elem *root = NULL;
+
+  /* First pass: link siblings in pairs, left to right, pushing
+     each pair onto a stack threaded through `next'. */
+  while (first != NULL)
+    {
+      struct heap_elem *a = first;
+      struct heap_elem *b = a->next;
+
+      if (b != NULL)
+        {
+          first = b->next;
+          a = link (h, a, b);
+        }
+      else
+        first = NULL;
+      a->next = pairs;
+      pairs = a;
+    }
+
+  /* Second pass: link the pairs into one tree, right to left. */
+  while (pairs != NULL)
+    {
+      struct heap_elem *next = pairs->next;
+      root = root != NULL ? link (h, root, pairs) : pairs;
+      pairs = next;
+    }
+
+  if (root != NULL)
+    root->next = root->prev = NULL;
+  return root;
+}
+
+/* Cuts E and its subtree out of its parent's child list.  E must
+   not be a root. */
+static void
+detach (struct heap_elem *e)
+{
+  ASSERT (e->prev != NULL);
+
+  if (e->prev->child == e)
+    e->prev->child = e->next;
+  else
+    e->prev->next = e->next;
+  if (e->next != NULL)
+    e->next->prev = e->prev;
+  e->next = e->prev = NULL;
+}
@@ -0,0 +1,73 @@
+#ifndef __LIB_KERNEL_HEAP_H
+#define __LIB_KERNEL_HEAP_H
+
+/* Priority queue.
+
+   This is a pairing heap: a tree, ordered so that every element
+   is no greater than its children, in which each node keeps its
+   children in a linked list.  Like lib/kernel/list.h, it does not
+   allocate memory.  Each structure that can be in a heap embeds
+   a struct heap_elem member, and heap_entry() converts a struct
+   heap_elem back to the structure that contains it.
+
+   The heap's order is given by a heap_less_func supplied to
+   heap_init().  heap_push() and heap_min() take constant time.
+   heap_pop_min() and heap_remove() take O(lg n) amortized time,
+   where list_insert_ordered() takes O(n).
+
+   An element's key may be lowered while it is in a heap, as long
+   as heap_decrease() is called right afterward.  To raise a key,
+   remove the element, change the key, and push it again.
+
+   A heap is not safe for concurrent access; callers must
+   synchronize as they would for a list. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Heap element. */
+struct heap_elem
+  {
+    struct heap_elem *child;    /* First child. */
+    struct heap_elem *next;     /* Next sibling. */
+    struct heap_elem *prev;     /* Previous sibling, or parent if first
+                                   child, or null if the root. */
+  };
+
+/* Converts pointer to heap element HEAP_ELEM into a pointer to
+   the structure that HEAP_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the heap element. */
+#define heap_entry(HEAP_ELEM, STRUCT, MEMBER)                   \
+        ((STRUCT *) ((uint8_t *) &(HEAP_ELEM)->child            \
+                     - offsetof (STRUCT, MEMBER.child)))
+
+/* Compares the value of two heap elements A and B, given
+   auxiliary data AUX.  Returns true if A is less than B, or
+   false if A is greater than or equal to B. */
+typedef bool heap_less_func (const struct heap_elem *a,
+                             const struct heap_elem *b,
+                             void *aux);
+
+/* Heap. */
+struct heap
+  {
+    struct heap_elem *root;     /* Least element, or null if empty. */
+    size_t elem_cnt;            /* Number of elements. */
+    heap_less_func *less;       /* Comparison function. */
+    void *aux;                  /* Auxiliary data for `less'. */
+  };
+
+void heap_init (struct heap *, heap_less_func *, void *aux);
+
+void heap_push (struct heap *, struct heap_elem *);
+struct heap_elem *heap_min (const struct heap *);
+struct heap_elem *heap_pop_min (struct heap *);
+void heap_decrease (struct heap *, struct heap_elem *);
+void heap_remove (struct heap *, struct heap_elem *);
+
+size_t heap_size (const struct heap *);
+bool heap_empty (const struct heap *);
+
+#endif /* lib/kernel/heap.h */
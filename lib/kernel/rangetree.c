@@ -0,0 +1,367 @@
+#include "rangetree.h"
+#include "../debug.h"
+
+/* The tree is an AVL tree: the heights of the two subtrees of
+   any node differ by at most one, so a tree of n ranges is at
+   most about 1.44 lg n high.  Insertion and removal recurse down
+   one path and rebalance with rotations on the way back up,
+   recomputing each touched node's height and augmented fields
+   from its children.  Because the ranges are disjoint, ordering
+   them by start also orders them by end, so a subtree's lowest
+   start is that of its leftmost node and its highest end is that
+   of its rightmost node. */
+
+static struct range_elem *insert_elem (struct range_elem *,
+                                       struct range_elem *);
+static struct range_elem *remove_elem (struct range_elem *,
+                                       struct range_elem *);
+static struct range_elem *remove_min (struct range_elem *,
+                                      struct range_elem **min);
+static struct range_elem *rebalance (struct range_elem *);
+static bool find_gap (const struct range_elem *, uintptr_t *cur,
+                      uintptr_t hi, size_t size);
+
+/* Initializes T as an empty range tree. */
+void
+range_init (struct range_tree *t)
+{
+  ASSERT (t != NULL);
+
+  t->root = NULL;
+  t->elem_cnt = 0;
+}
+
+/* Inserts E into T as the range [START, END).  Returns true if
+   successful, false if the range overlaps one already in T, in
+   which case T is unchanged.  START must be less than END. */
+bool
+range_insert (struct range_tree *t, struct range_elem *e,
+              uintptr_t start, uintptr_t end)
+{
+  ASSERT (t != NULL);
+  ASSERT (e != NULL);
+  ASSERT (start < end);
+
+  if (range_overlap (t, start, end) != NULL)
+    return false;
+
+  e->start = start;
+  e->end = end;
+  e->left = e->right = NULL;
+  t->root = insert_elem (t->root, e);
+  t->elem_cnt++;
+  return true;
+}
+
+/* Removes E, which must be in T, from T. */
+void
+range_remove (struct range_tree *t, struct range_elem *e)
+{
+  ASSERT (t != NULL);
+  ASSERT (e != NULL);
+
+  t->root = remove_elem (t->root, e);
+  t->elem_cnt--;
+}
+
+/* Returns the range in T that contains ADDR, or a null pointer
+   if there is none. */
+struct range_elem *
+range_find (const struct range_tree *t, uintptr_t addr)
+{
+  struct range_elem *n;
+
+  ASSERT (t != NULL);
+
+  n = t->root;
+  while (n != NULL)
+    if (addr < n->start)
+      n = n->left;
+    else if (addr >= n->end)
+      n = n->right;
+    else
+      return n;
+  return NULL;
+}
+
+/* Returns the lowest range in T that overlaps [START, END), or a
+   null pointer if there is none. */
+struct range_elem *
+range_overlap (const struct range_tree *t, uintptr_t start, uintptr_t end)
+{
+  struct range_elem *n, *found = NULL;
+
+  ASSERT (t != NULL);
+
+  n = t->root;
+  while (n != NULL)
+    if (n->end <= start)
+      n = n->right;
+    else
+      {
+        /* N ends after START, so N overlaps if it also starts
+           before END.  Either way, any lower overlapping range is
+           to the left. */
+        if (n->start < end)
+          found = n;
+        n = n->left;
+      }
+  return found;
+}
+
+/* Returns the lowest address A such that [A, A + SIZE) lies
+   within [LO, HI) and overlaps no range in T, or RANGE_ERROR if
+   there is no such address.  SIZE must be nonzero. */
+uintptr_t
+range_find_gap (const struct range_tree *t, uintptr_t lo, uintptr_t hi,
+                size_t size)
+{
+  uintptr_t cur = lo;
+
+  ASSERT (t != NULL);
+  ASSERT (size > 0);
+
+  if (find_gap (t->root, &cur, hi, size)
+      || (cur <= hi && hi - cur >= size))
+    return cur;
+  return RANGE_ERROR;
+}
+
+/* Returns the lowest range in T, or a null pointer if T is
+   empty. */
+struct range_elem *
+range_first (const struct range_tree *t)
+{
+  struct range_elem *n;
+
+  ASSERT (t != NULL);
+
+  n = t->root;
+  if (n != NULL)
+    while (n->left != NULL)
+      n = n->left;
+  return n;
+}
+
+/* Returns the range in T just above E, or a null pointer if E is
+   the highest range.  E must be in T. */
+struct range_elem *
+range_next (const struct range_tree *t, const struct range_elem *e)
+{
+  struct range_elem *n, *next = NULL;
+
+  ASSERT (t != NULL);
+  ASSERT (e != NULL);
+
+  n = t->root;
+  while (n != NULL)
+    if (n->start >= e->end)
+      {
+        next = n;
+        n = n->left;
+      }
+    else
+      n = n->right;
+  return next;
+}
+
+/* Returns the number of ranges in T. */
+size_t
+range_size (const struct range_tree *t)
+{
+  ASSERT (t != NULL);
+
+  return t->elem_cnt;
+}
+
+/* Returns true if T contains no ranges, false otherwise. */
+bool
+range_empty (const struct range_tree *t)
+{
+  ASSERT (t != NULL);
+
+  return t->root == NULL;
+}
+
+/* Returns the height of subtree N. */
+static inline int
+height (const struct range_elem *n)
+{
+  return n != NULL ? n->height : 0;
+}
+
+/* Returns the larger of A and B. */
+static inline uintptr_t
+max (uintptr_t a, uintptr_t b)
+{
+  return a > b ? a : b;
+}
+
+/* Recomputes N's height and augmented fields from its children,
+   which must be up to date. */
+static void
+update (struct range_elem *n)
+{
+  struct range_elem *l = n->left;
+  struct range_elem *r = n->right;
+
+  n->height = 1 + (height (l) > height (r) ? height (l) : height (r));
+  n->min_start = l != NULL ? l->min_start : n->start;
+  n->max_end = r != NULL ? r->max_end : n->end;
+  n->max_gap = 0;
+  if (l != NULL)
+    n->max_gap = max (l->max_gap, n->start - l->max_end);
+  if (r != NULL)
+    n->max_gap = max (n->max_gap, max (r->max_gap, r->min_start - n->end));
+}
+
+/* Rotates subtree N to the right and returns its new root. */
+static struct range_elem *
+rotate_right (struct range_elem *n)
+{
+  struct range_elem *l = n->left;
+
+  n->left = l->right;
+  l->right = n;
+  update (n);
+  update (l);
+  return l;
+}
+
+/* Rotates subtree N to the left and returns its new root. */
+static struct range_elem *
+rotate_left (struct range_elem *n)
+{
+  struct range_elem *r = n->right;
+
+  n->right = r->left;
+  r->left = n;
+  update (n);
+  update (r);
+  return r;
+}
+
+/* Updates N and, if its subtrees' heights differ by more than
+   one, rotates to restore balance.  Returns the subtree's new
+   root. */
+static struct range_elem *
+rebalance (struct range_elem *n)
+{
+  int balance = height (n->left) - height (n->right);
+
+  if (balance > 1)
+    {
+      if (height (n->left->left) < height (n->left->right))
+        n->left = rotate_left (n->left);
+      return rotate_right (n);
+    }
+  else if (balance < -1)
+    {
+      if (height (n->right->right) < height (n->right->left))
+        n->right = rotate_right (n->right);
+      return rotate_left (n);
+    }
+
+  update (n);
+  return n;
+}
+
+/* Inserts E into subtree N and returns the subtree's new
+   root. */
+static struct range_elem *
+insert_elem (struct range_elem *n, struct range_elem *e)
+{
+  if (n == NULL)
+    {
+      update (e);
+      return e;
+    }
+
+  if (e->start < n->start)
+    n->left = insert_elem (n->left, e);
+  else
+    n->right = insert_elem (n->right, e);
+  return rebalance (n);
+}
+
+/* Removes E from subtree N and returns the subtree's new root. */
+static struct range_elem *
+remove_elem (struct range_elem *n, struct range_elem *e)
+{
+  ASSERT (n != NULL);
+
+  if (e->start < n->start)
+    n->left = remove_elem (n->left, e);
+  else if (e->start > n->start)
+    n->right = remove_elem (n->right, e);
+  else
+    {
+      struct range_elem *min;
+
+      ASSERT (n == e);
+      if (e->left == NULL)
+        return e->right;
+      if (e->right == NULL)
+        return e->left;
+
+      /* Replace E by its successor. */
+      n = e->right;
+      n = remove_min (n, &min);
+      min->left = e->left;
+      min->right = n;
+      n = min;
+    }
+  return rebalance (n);
+}
+
+/* Removes the lowest range from subtree N, which must not be
+   empty, and stores it in *MIN.  Returns the subtree's new
+   root. */
+static struct range_elem *
+remove_min (struct range_elem *n, struct range_elem **min)
+{
+  if (n->left == NULL)
+    {
+      *min = n;
+      return n->right;
+    }
+
+  n->left = remove_min (n->left, min);
+  return rebalance (n);
+}
+
+/* Searches subtree N, in address order, for a gap of at least
+   SIZE bytes that starts at or after *CUR and ends at or before
+   HI.  *CUR is the start of the free space just before N's
+   subtree.  If a gap is found, returns true and sets *CUR to its
+   start.  Otherwise, returns false and advances *CUR past N's
+   subtree. */
+static bool
+find_gap (const struct range_elem *n, uintptr_t *cur, uintptr_t hi,
+          size_t size)
+{
+  uintptr_t gap_end;
+
+  if (n == NULL || *cur >= hi)
+    return false;
+
+  /* Skip the subtree if it lies wholly below *CUR, or if neither
+     its leading gap nor any gap inside it is wide enough. */
+  if (n->max_end <= *cur
+      || (n->max_gap < size
+          && (n->min_start <= *cur || n->min_start - *cur < size)))
+    {
+      *cur = max (*cur, n->max_end);
+      return false;
+    }
+
+  if (find_gap (n->left, cur, hi, size))
+    return true;
+
+  gap_end = n->start < hi ? n->start : hi;
+  if (gap_end > *cur && gap_end - *cur >= size)
+    return true;
+  *cur = max (*cur, n->end);
+
+  return find_gap (n->right, cur, hi, size);
+}
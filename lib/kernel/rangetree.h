@@ -0,0 +1,80 @@
+#ifndef __LIB_KERNEL_RANGETREE_H
+#define __LIB_KERNEL_RANGETREE_H
+
+/* Range tree.
+
+   A set of disjoint half-open address ranges [START, END), kept
+   in a balanced (AVL) binary search tree ordered by address.  It
+   answers "which range contains address X", "does [S, E) overlap
+   any range", and "where is the lowest free gap of N bytes" in
+   O(lg n) time, where a list needs O(n).
+
+   Like lib/kernel/list.h, a range tree does not allocate memory.
+   Each structure that can be in a tree embeds a struct
+   range_elem member, and range_entry() converts a struct
+   range_elem back to the structure that contains it.
+
+   Each node is augmented with the lowest start, highest end, and
+   widest gap between neighboring ranges in its subtree, which is
+   what lets gap searches skip whole subtrees.
+
+   A range tree is not safe for concurrent access; callers must
+   synchronize as they would for a list. */
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Range tree element. */
+struct range_elem
+  {
+    uintptr_t start;            /* First address in range. */
+    uintptr_t end;              /* One past the last address in range. */
+
+    /* Owned by rangetree.c. */
+    struct range_elem *left;    /* Ranges below this one. */
+    struct range_elem *right;   /* Ranges above this one. */
+    int height;                 /* Height of subtree, 1 for a leaf. */
+    uintptr_t min_start;        /* Lowest start in subtree. */
+    uintptr_t max_end;          /* Highest end in subtree. */
+    uintptr_t max_gap;          /* Widest gap between ranges in subtree. */
+  };
+
+/* Converts pointer to range element RANGE_ELEM into a pointer to
+   the structure that RANGE_ELEM is embedded inside.  Supply the
+   name of the outer structure STRUCT and the member name MEMBER
+   of the range element. */
+#define range_entry(RANGE_ELEM, STRUCT, MEMBER)                 \
+        ((STRUCT *) ((uint8_t *) &(RANGE_ELEM)->start           \
+                     - offsetof (STRUCT, MEMBER.start)))
+
+/* Range tree. */
+struct range_tree
+  {
+    struct range_elem *root;    /* Root of tree, or null if empty. */
+    size_t elem_cnt;            /* Number of ranges. */
+  };
+
+/* Returned by range_find_gap() if no gap is found. */
+#define RANGE_ERROR UINTPTR_MAX
+
+void range_init (struct range_tree *);
+
+bool range_insert (struct range_tree *, struct range_elem *,
+                   uintptr_t start, uintptr_t end);
+void range_remove (struct range_tree *, struct range_elem *);
+
+struct range_elem *range_find (const struct range_tree *, uintptr_t);
+struct range_elem *range_overlap (const struct range_tree *,
+                                  uintptr_t start, uintptr_t end);
+uintptr_t range_find_gap (const struct range_tree *,
+                          uintptr_t lo, uintptr_t hi, size_t size);
+
+struct range_elem *range_first (const struct range_tree *);
+struct range_elem *range_next (const struct range_tree *,
+                               const struct range_elem *);
+
+size_t range_size (const struct range_tree *);
+bool range_empty (const struct range_tree *);
+
+#endif /* lib/kernel/rangetree.h */
@@ -0,0 +1,192 @@
+/* Test program for lib/kernel/bitmap.c.
+
+   Checks bitmap_scan(), bitmap_count(), bitmap_contains() and
+   bitmap_set_multiple() against simple bit-at-a-time versions on
+   random bitmaps, then times bitmap_scan() against the
+   bit-at-a-time version on a 64K-bit map.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <bitmap.h>
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Maximum number of bits in a bitmap that we will test. */
+#define MAX_BITS 300
+
+/* Number of bits in the benchmark bitmap. */
+#define BENCH_BITS 65536
+
+/* Number of scans timed in the benchmark. */
+#define BENCH_SCANS 64
+
+static void set_random (struct bitmap *, int density);
+static size_t slow_scan (const struct bitmap *, size_t start, size_t cnt,
+                         bool value);
+static size_t slow_count (const struct bitmap *, size_t start, size_t cnt,
+                          bool value);
+static void verify_queries (const struct bitmap *);
+static void verify_set_multiple (const struct bitmap *);
+static void benchmark (void);
+
+/* Test the bitmap implementation. */
+void
+test (void)
+{
+  size_t bit_cnt;
+
+  printf ("testing various size bitmaps:");
+  for (bit_cnt = 0; bit_cnt < MAX_BITS; bit_cnt = bit_cnt * 4 / 3 + 1)
+    {
+      int repeat;
+
+      printf (" %zu", bit_cnt);
+      for (repeat = 0; repeat < 10; repeat++)
+        {
+          struct bitmap *b = bitmap_create (bit_cnt);
+          ASSERT (b != NULL);
+          set_random (b, repeat * 10);
+          verify_queries (b);
+          verify_set_multiple (b);
+          bitmap_destroy (b);
+        }
+    }
+  printf (" done\n");
+
+  benchmark ();
+}
+
+/* Sets about DENSITY percent of the bits in B, at random. */
+static void
+set_random (struct bitmap *b, int density)
+{
+  size_t i;
+
+  bitmap_set_all (b, false);
+  for (i = 0; i < bitmap_size (b); i++)
+    if ((int) (random_ulong () % 100) < density)
+      bitmap_mark (b, i);
+}
+
+/* Bit-at-a-time version of bitmap_scan(). */
+static size_t
+slow_scan (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  if (cnt <= bitmap_size (b))
+    {
+      size_t last = bitmap_size (b) - cnt;
+      size_t i;
+
+      for (i = start; i <= last; i++)
+        if (slow_count (b, i, cnt, value) == cnt)
+          return i;
+    }
+  return BITMAP_ERROR;
+}
+
+/* Bit-at-a-time version of bitmap_count(). */
+static size_t
+slow_count (const struct bitmap *b, size_t start, size_t cnt, bool value)
+{
+  size_t value_cnt = 0;
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    if (bitmap_test (b, start + i) == value)
+      value_cnt++;
+  return value_cnt;
+}
+
+/* Checks the multi-bit queries on B against the bit-at-a-time
+   versions, for every start and a range of lengths. */
+static void
+verify_queries (const struct bitmap *b)
+{
+  size_t bit_cnt = bitmap_size (b);
+  size_t start, cnt;
+
+  for (start = 0; start <= bit_cnt; start++)
+    for (cnt = 0; start + cnt <= bit_cnt && cnt < 40; cnt++)
+      {
+        int value;
+
+        for (value = 0; value <= 1; value++)
+          {
+            size_t value_cnt = slow_count (b, start, cnt, value);
+            ASSERT (bitmap_count (b, start, cnt, value) == value_cnt);
+            ASSERT (bitmap_contains (b, start, cnt, value)
+                    == (value_cnt > 0));
+            ASSERT (bitmap_scan (b, start, cnt, value)
+                    == slow_scan (b, start, cnt, value));
+          }
+        ASSERT (bitmap_any (b, start, cnt)
+                == (slow_count (b, start, cnt, true) > 0));
+        ASSERT (bitmap_all (b, start, cnt)
+                == (slow_count (b, start, cnt, true) == cnt));
+      }
+}
+
+/* Checks bitmap_set_multiple() on copies of B. */
+static void
+verify_set_multiple (const struct bitmap *b)
+{
+  size_t bit_cnt = bitmap_size (b);
+  struct bitmap *copy = bitmap_create (bit_cnt);
+  int repeat;
+
+  ASSERT (copy != NULL);
+  for (repeat = 0; repeat < 20 && bit_cnt > 0; repeat++)
+    {
+      size_t start = random_ulong () % bit_cnt;
+      size_t cnt = random_ulong () % (bit_cnt - start + 1);
+      bool value = random_ulong () % 2;
+      size_t i;
+
+      for (i = 0; i < bit_cnt; i++)
+        bitmap_set (copy, i, bitmap_test (b, i));
+      bitmap_set_multiple (copy, start, cnt, value);
+      for (i = 0; i < bit_cnt; i++)
+        ASSERT (bitmap_test (copy, i) == (i >= start && i < start + cnt
+                                          ? value : bitmap_test (b, i)));
+    }
+  bitmap_destroy (copy);
+}
+
+/* Times BENCH_SCANS scans for a run of free bits in a mostly
+   full 64K-bit map, as the page allocator and free map do, with
+   bitmap_scan() and with the bit-at-a-time version. */
+static void
+benchmark (void)
+{
+  struct bitmap *b = bitmap_create (BENCH_BITS);
+  int64_t start;
+  int64_t fast_ticks, slow_ticks;
+  size_t fast_idx = 0, slow_idx = 0;
+  int i;
+
+  ASSERT (b != NULL);
+  set_random (b, 90);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_SCANS; i++)
+    fast_idx = bitmap_scan (b, 0, 4, false);
+  fast_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_SCANS; i++)
+    slow_idx = slow_scan (b, 0, 4, false);
+  slow_ticks = timer_elapsed (start);
+
+  ASSERT (fast_idx == slow_idx);
+  printf ("%d scans of a %d-bit map: %"PRId64" ticks word-at-a-time, "
+          "%"PRId64" ticks bit-at-a-time\n",
+          BENCH_SCANS, BENCH_BITS, fast_ticks, slow_ticks);
+  bitmap_destroy (b);
+}
@@ -0,0 +1,135 @@
+/* Test program for lib/kernel/hash.c.
+
+   Grows and shrinks a hash table by random insertions and
+   deletions, so that it is often in the middle of an incremental
+   resize, and checks lookups, iteration and hash_stats() against
+   a plain array as it goes.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <hash.h>
+#include <random.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Number of distinct keys. */
+#define KEY_CNT 4096
+
+/* Number of random operations per phase. */
+#define PHASE_OPS 20000
+
+/* A hash table element. */
+struct value
+  {
+    struct hash_elem elem;      /* Hash table element. */
+    int key;                    /* Key. */
+  };
+
+static struct value values[KEY_CNT];
+static bool present[KEY_CNT];
+
+static hash_hash_func value_hash;
+static hash_less_func value_less;
+static void verify_table (struct hash *, size_t cnt);
+
+/* Test the hash table implementation. */
+void
+test (void)
+{
+  struct hash h;
+  size_t cnt = 0;
+  int phase, i;
+
+  ASSERT (hash_init (&h, value_hash, value_less, NULL));
+  for (i = 0; i < KEY_CNT; i++)
+    values[i].key = i;
+
+  printf ("testing growing and shrinking tables:");
+  for (phase = 0; phase < 6; phase++)
+    {
+      /* Even phases mostly insert, odd phases mostly delete. */
+      int insert_pct = phase % 2 == 0 ? 75 : 25;
+      int op;
+
+      printf (" %d", phase);
+      for (op = 0; op < PHASE_OPS; op++)
+        {
+          int key = random_ulong () % KEY_CNT;
+          struct hash_elem *old;
+
+          if ((int) (random_ulong () % 100) < insert_pct)
+            {
+              old = hash_insert (&h, &values[key].elem);
+              ASSERT (old == (present[key] ? &values[key].elem : NULL));
+              if (!present[key])
+                cnt++;
+              present[key] = true;
+            }
+          else
+            {
+              old = hash_delete (&h, &values[key].elem);
+              ASSERT (old == (present[key] ? &values[key].elem : NULL));
+              if (present[key])
+                cnt--;
+              present[key] = false;
+            }
+          ASSERT (hash_size (&h) == cnt);
+
+          if (op % 1000 == 0)
+            verify_table (&h, cnt);
+        }
+    }
+  printf (" done\n");
+
+  hash_clear (&h, NULL);
+  ASSERT (hash_empty (&h));
+  hash_destroy (&h, NULL);
+}
+
+/* Checks that H holds exactly the CNT present values. */
+static void
+verify_table (struct hash *h, size_t cnt)
+{
+  struct hash_iterator i;
+  struct hash_stats stats;
+  size_t seen = 0;
+  int key;
+
+  hash_first (&i, h);
+  while (hash_next (&i))
+    {
+      struct value *v = hash_entry (hash_cur (&i), struct value, elem);
+      ASSERT (present[v->key]);
+      seen++;
+    }
+  ASSERT (seen == cnt);
+
+  for (key = 0; key < KEY_CNT; key++)
+    ASSERT ((hash_find (h, &values[key].elem) != NULL) == present[key]);
+
+  hash_stats (h, &stats);
+  ASSERT (stats.elem_cnt == cnt);
+  ASSERT (stats.used_bucket_cnt <= stats.bucket_cnt);
+  ASSERT (stats.used_bucket_cnt <= cnt);
+  ASSERT (cnt == 0 || stats.longest_chain > 0);
+}
+
+/* Returns a hash of the value in E. */
+static unsigned
+value_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct value, elem)->key);
+}
+
+/* Returns true if value A is less than value B. */
+static bool
+value_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct value, elem)->key
+          < hash_entry (b, struct value, elem)->key);
+}
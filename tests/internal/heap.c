@@ -0,0 +1,221 @@
+/* Test program for lib/kernel/heap.c.
+
+   Runs random pushes, pops, key decreases and removals on heaps
+   of various sizes, checking each result against a linear search
+   of the elements, then times a heap against an ordered list
+   used as a priority queue.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <heap.h>
+#include <inttypes.h>
+#include <list.h>
+#include <random.h>
+#include <stdio.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+
+/* Maximum number of elements in a heap that we will test. */
+#define MAX_SIZE 256
+
+/* Number of elements in the benchmark queues. */
+#define BENCH_SIZE 2048
+
+/* A heap or list element. */
+struct value
+  {
+    struct heap_elem heap_elem; /* Heap element. */
+    struct list_elem list_elem; /* List element. */
+    int key;                    /* Key. */
+    bool in_heap;               /* In the heap being tested? */
+  };
+
+static struct value values[BENCH_SIZE];
+
+static heap_less_func value_less;
+static list_less_func value_list_less;
+static void test_size (int size);
+static struct value *slow_min (int size);
+static void benchmark (void);
+
+/* Test the heap implementation. */
+void
+test (void)
+{
+  int size;
+
+  printf ("testing various size heaps:");
+  for (size = 1; size <= MAX_SIZE; size *= 2)
+    {
+      int repeat;
+
+      printf (" %d", size);
+      for (repeat = 0; repeat < 10; repeat++)
+        test_size (size);
+    }
+  printf (" done\n");
+
+  benchmark ();
+}
+
+/* Runs random operations on a heap whose elements are drawn from
+   the first SIZE of `values'. */
+static void
+test_size (int size)
+{
+  struct heap h;
+  size_t cnt = 0;
+  int op, i;
+
+  heap_init (&h, value_less, NULL);
+  for (i = 0; i < size; i++)
+    values[i].in_heap = false;
+
+  for (op = 0; op < size * 8; op++)
+    {
+      struct value *v = &values[random_ulong () % size];
+      struct value *min;
+
+      switch (random_ulong () % 4)
+        {
+        case 0:
+        case 1:
+          /* Push, with a small key range so that there are
+             plenty of ties. */
+          if (!v->in_heap)
+            {
+              v->key = random_ulong () % (size * 2);
+              v->in_heap = true;
+              heap_push (&h, &v->heap_elem);
+              cnt++;
+            }
+          break;
+
+        case 2:
+          /* Decrease a key, or remove an element. */
+          if (v->in_heap)
+            {
+              if (random_ulong () % 2)
+                {
+                  v->key -= random_ulong () % (size + 1);
+                  heap_decrease (&h, &v->heap_elem);
+                }
+              else
+                {
+                  heap_remove (&h, &v->heap_elem);
+                  v->in_heap = false;
+                  cnt--;
+                }
+            }
+          break;
+
+        case 3:
+          /* Pop the minimum. */
+          min = slow_min (size);
+          if (min == NULL)
+            {
+              ASSERT (heap_pop_min (&h) == NULL);
+            }
+          else
+            {
+              v = heap_entry (heap_pop_min (&h), struct value, heap_elem);
+              ASSERT (v->in_heap);
+              ASSERT (v->key == min->key);
+              v->in_heap = false;
+              cnt--;
+            }
+          break;
+        }
+
+      ASSERT (heap_size (&h) == cnt);
+      ASSERT (heap_empty (&h) == (cnt == 0));
+      min = slow_min (size);
+      ASSERT (min == NULL ? heap_min (&h) == NULL
+              : (heap_entry (heap_min (&h), struct value, heap_elem)->key
+                 == min->key));
+    }
+
+  /* Drain the heap, checking that keys come out in order. */
+  while (!heap_empty (&h))
+    {
+      struct value *v = heap_entry (heap_pop_min (&h), struct value,
+                                    heap_elem);
+      struct value *min = slow_min (size);
+      ASSERT (min != NULL && v->key == min->key);
+      v->in_heap = false;
+      cnt--;
+    }
+  ASSERT (cnt == 0);
+}
+
+/* Returns an element with the least key among the first SIZE
+   values that are in the heap, or a null pointer if none is. */
+static struct value *
+slow_min (int size)
+{
+  struct value *min = NULL;
+  int i;
+
+  for (i = 0; i < size; i++)
+    if (values[i].in_heap && (min == NULL || values[i].key < min->key))
+      min = &values[i];
+  return min;
+}
+
+/* Times pushing BENCH_SIZE random keys and then popping them all,
+   with a heap and with list_insert_ordered() on a list, as the
+   kernel's ordered queues do. */
+static void
+benchmark (void)
+{
+  struct heap h;
+  struct list l;
+  int64_t start;
+  int64_t heap_ticks, list_ticks;
+  int i;
+
+  for (i = 0; i < BENCH_SIZE; i++)
+    values[i].key = random_ulong () % BENCH_SIZE;
+
+  heap_init (&h, value_less, NULL);
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_SIZE; i++)
+    heap_push (&h, &values[i].heap_elem);
+  for (i = 0; i < BENCH_SIZE; i++)
+    heap_pop_min (&h);
+  heap_ticks = timer_elapsed (start);
+
+  list_init (&l);
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_SIZE; i++)
+    list_insert_ordered (&l, &values[i].list_elem, value_list_less, NULL);
+  for (i = 0; i < BENCH_SIZE; i++)
+    list_pop_front (&l);
+  list_ticks = timer_elapsed (start);
+
+  printf ("%d pushes and pops: %"PRId64" ticks with a heap, "
+          "%"PRId64" ticks with an ordered list\n",
+          BENCH_SIZE, heap_ticks, list_ticks);
+}
+
+/* Returns true if value A's key is less than value B's. */
+static bool
+value_less (const struct heap_elem *a, const struct heap_elem *b,
+            void *aux UNUSED)
+{
+  return (heap_entry (a, struct value, heap_elem)->key
+          < heap_entry (b, struct value, heap_elem)->key);
+}
+
+/* Returns true if value A's key is less than value B's. */
+static bool
+value_list_less (const struct list_elem *a, const struct list_elem *b,
+                 void *aux UNUSED)
+{
+  return (list_entry (a, struct value, list_elem)->key
+          < list_entry (b, struct value, list_elem)->key);
+}
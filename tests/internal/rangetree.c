@@ -0,0 +1,196 @@
+/* Test program for lib/kernel/rangetree.c.
+
+   Inserts and removes random ranges in a small address space,
+   checking every query against a map of which range owns each
+   address, and checking the tree's balance and augmented fields
+   after each change.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <rangetree.h>
+#include <stdio.h>
+#include "threads/test.h"
+
+/* Size of the address space. */
+#define SPACE 512
+
+/* Maximum number of ranges. */
+#define MAX_RANGES 64
+
+/* Number of random operations. */
+#define OP_CNT 5000
+
+/* A range. */
+struct region
+  {
+    struct range_elem elem;     /* Range tree element. */
+    bool in_tree;               /* In the tree? */
+  };
+
+static struct region regions[MAX_RANGES];
+
+/* Region owning each address, or null. */
+static struct region *owner[SPACE];
+
+static void verify_queries (struct range_tree *);
+static int verify_subtree (const struct range_elem *, uintptr_t lo,
+                           uintptr_t hi);
+static uintptr_t slow_find_gap (uintptr_t lo, uintptr_t hi, size_t size);
+
+/* Test the range tree implementation. */
+void
+test (void)
+{
+  struct range_tree t;
+  int op;
+
+  range_init (&t);
+  printf ("testing range tree:");
+  for (op = 0; op < OP_CNT; op++)
+    {
+      struct region *r = &regions[random_ulong () % MAX_RANGES];
+
+      if (!r->in_tree)
+        {
+          uintptr_t start = random_ulong () % SPACE;
+          uintptr_t end = start + 1 + random_ulong () % 16;
+          bool vacant = true;
+          uintptr_t a;
+
+          if (end > SPACE)
+            end = SPACE;
+          for (a = start; a < end; a++)
+            if (owner[a] != NULL)
+              vacant = false;
+
+          ASSERT (range_insert (&t, &r->elem, start, end) == vacant);
+          if (vacant)
+            {
+              r->in_tree = true;
+              for (a = start; a < end; a++)
+                owner[a] = r;
+            }
+        }
+      else
+        {
+          uintptr_t a;
+
+          range_remove (&t, &r->elem);
+          r->in_tree = false;
+          for (a = r->elem.start; a < r->elem.end; a++)
+            owner[a] = NULL;
+        }
+
+      verify_subtree (t.root, 0, SPACE);
+      if (op % 50 == 0)
+        {
+          printf (" %zu", range_size (&t));
+          verify_queries (&t);
+        }
+    }
+  printf (" done\n");
+}
+
+/* Checks range_find(), range_overlap(), range_find_gap() and
+   iteration on T against the `owner' map. */
+static void
+verify_queries (struct range_tree *t)
+{
+  struct range_elem *e;
+  uintptr_t a, end;
+  size_t cnt = 0, size;
+
+  for (a = 0; a < SPACE; a++)
+    {
+      e = range_find (t, a);
+      ASSERT (owner[a] == (e != NULL
+                           ? range_entry (e, struct region, elem) : NULL));
+    }
+
+  for (a = 0; a < SPACE; a += 7)
+    for (end = a + 1; end <= SPACE; end += 13)
+      {
+        uintptr_t b;
+
+        e = range_overlap (t, a, end);
+        for (b = a; b < end && owner[b] == NULL; b++)
+          continue;
+        if (b < end)
+          {
+            ASSERT (e != NULL);
+            ASSERT (range_entry (e, struct region, elem) == owner[b]);
+          }
+        else
+          ASSERT (e == NULL);
+      }
+
+  for (size = 1; size <= 32; size++)
+    for (a = 0; a < SPACE; a += 37)
+      ASSERT (range_find_gap (t, a, SPACE - a / 2, size)
+              == slow_find_gap (a, SPACE - a / 2, size));
+
+  for (e = range_first (t); e != NULL; e = range_next (t, e))
+    {
+      ASSERT (owner[e->start] == range_entry (e, struct region, elem));
+      cnt++;
+    }
+  ASSERT (cnt == range_size (t));
+}
+
+/* Checks that the subtree rooted at N is ordered, lies within
+   [LO, HI), is balanced, and has correct augmented fields.
+   Returns its height. */
+static int
+verify_subtree (const struct range_elem *n, uintptr_t lo, uintptr_t hi)
+{
+  int lh, rh;
+  uintptr_t gap = 0;
+
+  if (n == NULL)
+    return 0;
+
+  ASSERT (lo <= n->start && n->start < n->end && n->end <= hi);
+  lh = verify_subtree (n->left, lo, n->start);
+  rh = verify_subtree (n->right, n->end, hi);
+  ASSERT (lh - rh >= -1 && lh - rh <= 1);
+  ASSERT (n->height == 1 + (lh > rh ? lh : rh));
+
+  ASSERT (n->min_start == (n->left ? n->left->min_start : n->start));
+  ASSERT (n->max_end == (n->right ? n->right->max_end : n->end));
+  if (n->left != NULL)
+    {
+      gap = n->start - n->left->max_end;
+      if (n->left->max_gap > gap)
+        gap = n->left->max_gap;
+    }
+  if (n->right != NULL)
+    {
+      if (n->right->min_start - n->end > gap)
+        gap = n->right->min_start - n->end;
+      if (n->right->max_gap > gap)
+        gap = n->right->max_gap;
+    }
+  ASSERT (n->max_gap == gap);
+
+  return n->height;
+}
+
+/* Address-at-a-time version of range_find_gap(). */
+static uintptr_t
+slow_find_gap (uintptr_t lo, uintptr_t hi, size_t size)
+{
+  uintptr_t a, run = 0;
+
+  for (a = lo; a < hi; a++)
+    {
+      run = owner[a] == NULL ? run + 1 : 0;
+      if (run == size)
+        return a + 1 - size;
+    }
+  return RANGE_ERROR;
+}
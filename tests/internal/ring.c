@@ -0,0 +1,129 @@
+/* Test program for devices/ring.c.
+
+   Streams bytes and then records of random sizes through small
+   rings in randomly sized pieces, checking that everything comes
+   out in order and that the ring's counts stay consistent.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <random.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "devices/ring.h"
+#include "threads/test.h"
+
+/* Largest ring size that we will test. */
+#define MAX_SIZE 256
+
+/* Number of bytes or records sent through each ring. */
+#define SEND_CNT 4096
+
+static uint8_t ring_buf[MAX_SIZE];
+
+static void test_bytes (size_t size);
+static void test_records (size_t size);
+
+/* Test the ring buffer implementation. */
+void
+test (void)
+{
+  size_t size;
+
+  printf ("testing various size rings:");
+  for (size = 1; size <= MAX_SIZE; size *= 2)
+    {
+      printf (" %zu", size);
+      test_bytes (size);
+      if (size >= 16)
+        test_records (size);
+    }
+  printf (" done\n");
+}
+
+/* Streams SEND_CNT bytes through a SIZE-byte ring. */
+static void
+test_bytes (size_t size)
+{
+  struct ring r;
+  uint8_t buf[MAX_SIZE + 1];
+  unsigned sent = 0, received = 0;
+
+  ring_init (&r, ring_buf, size);
+  while (received < SEND_CNT)
+    {
+      size_t cnt = random_ulong () % (size + 2);
+      size_t room = ring_room (&r);
+      size_t used = ring_used (&r);
+      size_t i, n;
+
+      ASSERT (used + room == size);
+      ASSERT (ring_empty (&r) == (used == 0));
+      ASSERT (ring_full (&r) == (room == 0));
+
+      if (random_ulong () % 2 && sent < SEND_CNT)
+        {
+          for (i = 0; i < cnt; i++)
+            buf[i] = sent + i;
+          n = ring_write (&r, buf, cnt);
+          ASSERT (n == (cnt < room ? cnt : room));
+          sent += n;
+        }
+      else
+        {
+          n = ring_read (&r, buf, cnt);
+          ASSERT (n == (cnt < used ? cnt : used));
+          for (i = 0; i < n; i++)
+            ASSERT (buf[i] == (uint8_t) (received + i));
+          received += n;
+        }
+      ASSERT (ring_used (&r) == sent - received);
+    }
+}
+
+/* Sends SEND_CNT records of random sizes through a SIZE-byte
+   ring.  Each record is filled with its sequence number. */
+static void
+test_records (size_t size)
+{
+  struct ring r;
+  uint8_t buf[MAX_SIZE];
+  unsigned sent = 0, received = 0;
+  size_t max_rec = size - sizeof (size_t);
+
+  ring_init (&r, ring_buf, size);
+  while (received < SEND_CNT)
+    {
+      size_t i;
+
+      if (random_ulong () % 2 && sent < SEND_CNT)
+        {
+          size_t rec_size = 1 + random_ulong () % max_rec;
+          bool fits = ring_room (&r) >= sizeof (size_t) + rec_size;
+
+          for (i = 0; i < rec_size; i++)
+            buf[i] = sent;
+          ASSERT (ring_put (&r, buf, rec_size) == fits);
+          if (fits)
+            sent++;
+        }
+      else
+        {
+          size_t rec_size = ring_peek_size (&r);
+          size_t max = random_ulong () % (max_rec + 1);
+
+          ASSERT ((rec_size == 0) == (sent == received));
+          ASSERT (ring_get (&r, buf, max) == rec_size);
+          if (rec_size > 0)
+            {
+              for (i = 0; i < rec_size && i < max; i++)
+                ASSERT (buf[i] == (uint8_t) received);
+              received++;
+            }
+        }
+    }
+  ASSERT (ring_empty (&r));
+}
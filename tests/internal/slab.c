@@ -0,0 +1,64 @@
+/* Test program for threads/slab.c.
+
+   Allocates objects from a cache until the kernel pool runs dry,
+   which makes the page allocator ask the caches' shrinker for
+   memory while this thread is inside the cache, holding its
+   lock.  Then frees everything and checks that the cache still
+   works.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <stdio.h>
+#include "threads/slab.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* An object, big enough that the pool empties quickly.  Live
+   objects are chained together through `next'. */
+struct obj
+  {
+    struct obj *next;
+    char pad[PGSIZE / 4 - sizeof (struct obj *)];
+  };
+
+/* Test the object cache implementation. */
+void
+test (void)
+{
+  struct kmem_cache *cache;
+  struct obj *head = NULL;
+  struct obj *o;
+  size_t cnt = 0;
+
+  cache = kmem_cache_create ("test", sizeof (struct obj), NULL);
+  ASSERT (cache != NULL);
+
+  printf ("allocating until out of memory...");
+  while ((o = kmem_cache_alloc (cache)) != NULL)
+    {
+      o->next = head;
+      head = o;
+      cnt++;
+    }
+  printf (" %zu objects\n", cnt);
+  ASSERT (cnt > 0);
+
+  /* Allocation fails cleanly again, with the pool still empty. */
+  ASSERT (kmem_cache_alloc (cache) == NULL);
+
+  while (head != NULL)
+    {
+      o = head;
+      head = head->next;
+      kmem_cache_free (cache, o);
+    }
+
+  o = kmem_cache_alloc (cache);
+  ASSERT (o != NULL);
+  kmem_cache_free (cache, o);
+  printf ("done\n");
+}
@@ -0,0 +1,222 @@
+/* Test program for the block functions in lib/string.c.
+
+   Checks memcpy(), memmove(), memset() and memcmp() against
+   simple byte-at-a-time versions for every combination of small
+   sizes and alignments, including overlapping moves, then
+   measures page copy and zero bandwidth against the byte loops.
+
+   This is not a test we will run on your submitted projects.
+   It is here for completeness.
+*/
+
+#undef NDEBUG
+#include <debug.h>
+#include <inttypes.h>
+#include <random.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "threads/test.h"
+#include "threads/vaddr.h"
+
+/* Largest block size that we will test. */
+#define MAX_SIZE 80
+
+/* Alignments tested are 0...ALIGN_CNT - 1. */
+#define ALIGN_CNT 8
+
+/* Size of the test buffers: room for a block and its alignment
+   offset on each side. */
+#define BUF_SIZE (MAX_SIZE + 2 * ALIGN_CNT)
+
+/* Number of page copies or fills timed in the benchmark. */
+#define BENCH_PAGES 2048
+
+static unsigned char orig[BUF_SIZE];
+static unsigned char buf[BUF_SIZE];
+static unsigned char expect[BUF_SIZE];
+
+static void fill_random (unsigned char *, size_t);
+static void slow_move (unsigned char *dst, const unsigned char *src,
+                       size_t size);
+static bool slow_equal (const unsigned char *, const unsigned char *,
+                        size_t size);
+static void test_moves (void);
+static void test_memset (void);
+static void test_memcmp (void);
+static void benchmark (void);
+
+/* Test the block functions. */
+void
+test (void)
+{
+  printf ("testing memcpy and memmove...");
+  test_moves ();
+  printf (" memset...");
+  test_memset ();
+  printf (" memcmp...");
+  test_memcmp ();
+  printf (" done\n");
+
+  benchmark ();
+}
+
+/* Fills the SIZE bytes at P with random bytes. */
+static void
+fill_random (unsigned char *p, size_t size)
+{
+  while (size-- > 0)
+    *p++ = random_ulong ();
+}
+
+/* Byte-at-a-time version of memmove(). */
+static void
+slow_move (unsigned char *dst, const unsigned char *src, size_t size)
+{
+  size_t i;
+
+  if (dst < src)
+    for (i = 0; i < size; i++)
+      dst[i] = src[i];
+  else
+    for (i = size; i-- > 0; )
+      dst[i] = src[i];
+}
+
+/* Returns true if the SIZE bytes at A and B are equal, checked
+   a byte at a time. */
+static bool
+slow_equal (const unsigned char *a, const unsigned char *b, size_t size)
+{
+  size_t i;
+
+  for (i = 0; i < size; i++)
+    if (a[i] != b[i])
+      return false;
+  return true;
+}
+
+/* Checks memmove(), and memcpy() where the blocks do not
+   overlap, for every size and for every pair of offsets up to
+   twice the alignment, which covers every relative alignment and
+   both directions of overlap. */
+static void
+test_moves (void)
+{
+  size_t size, dst, src;
+
+  fill_random (orig, BUF_SIZE);
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (dst = 0; dst < 2 * ALIGN_CNT; dst++)
+      for (src = 0; src < 2 * ALIGN_CNT; src++)
+        {
+          bool overlap = dst < src + size && src < dst + size;
+
+          slow_move (buf, orig, BUF_SIZE);
+          slow_move (expect, orig, BUF_SIZE);
+          slow_move (expect + dst, expect + src, size);
+
+          if (overlap)
+            {
+              ASSERT (memmove (buf + dst, buf + src, size) == buf + dst);
+            }
+          else
+            {
+              ASSERT (memcpy (buf + dst, buf + src, size) == buf + dst);
+            }
+          ASSERT (slow_equal (buf, expect, BUF_SIZE));
+        }
+}
+
+/* Checks memset() for every size and alignment. */
+static void
+test_memset (void)
+{
+  size_t size, ofs, i;
+
+  fill_random (orig, BUF_SIZE);
+  for (size = 0; size <= MAX_SIZE; size++)
+    for (ofs = 0; ofs < ALIGN_CNT; ofs++)
+      {
+        int value = random_ulong () % 512 - 128;
+
+        slow_move (buf, orig, BUF_SIZE);
+        slow_move (expect, orig, BUF_SIZE);
+        for (i = 0; i < size; i++)
+          expect[ofs + i] = value;
+
+        ASSERT (memset (buf + ofs, value, size) == buf + ofs);
+        ASSERT (slow_equal (buf, expect, BUF_SIZE));
+      }
+}
+
+/* Checks memcmp() for every size and pair of alignments, with
+   the blocks differing in at most one byte. */
+static void
+test_memcmp (void)
+{
+  size_t size, a, b, diff;
+
+  for (size = 1; size <= MAX_SIZE; size++)
+    for (a = 0; a < ALIGN_CNT; a++)
+      for (b = 0; b < ALIGN_CNT; b++)
+        {
+          unsigned char *pa = buf + a;
+          unsigned char *pb = expect + b;
+          size_t i;
+
+          fill_random (pa, size);
+          for (i = 0; i < size; i++)
+            pb[i] = pa[i];
+          ASSERT (memcmp (pa, pb, size) == 0);
+
+          diff = random_ulong () % size;
+          pb[diff] = pa[diff] + 1 + random_ulong () % 255;
+          ASSERT (memcmp (pa, pb, size) == (pa[diff] > pb[diff] ? 1 : -1));
+          ASSERT (memcmp (pa, pb, diff) == 0);
+        }
+}
+
+/* Times BENCH_PAGES page copies and page fills, as done for each
+   page loaded or zeroed, with the block functions and with byte
+   loops. */
+static void
+benchmark (void)
+{
+  static unsigned char pages[2][PGSIZE];
+  volatile unsigned char *dst = pages[0];
+  int64_t start;
+  int64_t copy_ticks, slow_copy_ticks, zero_ticks, slow_zero_ticks;
+  int i;
+  size_t j;
+
+  fill_random (pages[1], PGSIZE);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_PAGES; i++)
+    memcpy (pages[0], pages[1], PGSIZE);
+  copy_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_PAGES; i++)
+    for (j = 0; j < PGSIZE; j++)
+      dst[j] = pages[1][j];
+  slow_copy_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_PAGES; i++)
+    memset (pages[0], 0, PGSIZE);
+  zero_ticks = timer_elapsed (start);
+
+  start = timer_ticks ();
+  for (i = 0; i < BENCH_PAGES; i++)
+    for (j = 0; j < PGSIZE; j++)
+      dst[j] = 0;
+  slow_zero_ticks = timer_elapsed (start);
+
+  printf ("%d page copies: %"PRId64" ticks, %"PRId64" ticks bytewise\n",
+          BENCH_PAGES, copy_ticks, slow_copy_ticks);
+  printf ("%d page zeroes: %"PRId64" ticks, %"PRId64" ticks bytewise\n",
+          BENCH_PAGES, zero_ticks, slow_zero_ticks);
+}
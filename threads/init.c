@@ -21,6 +21,8 @@
 #include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/pte.h"
+#include "threads/shrink.h"
+#include "threads/slab.h"
 #include "threads/thread.h"
 #ifdef USERPROG
 #include "userprog/process.h"
@@ -31,6 +33,9 @@
 #else
 #include "tests/threads/tests.h"
 #endif
+#ifdef VM
+#include "vm/page.h"
+#endif
 #ifdef FILESYS
 #include "devices/block.h"
 #include "devices/ide.h"
@@ -95,9 +100,14 @@ main (void)
           init_ram_pages * PGSIZE / 1024);
 
   /* Initialize memory system. */
+  shrinker_init ();
   palloc_init (user_page_limit);
   malloc_init ();
+  kmem_init ();
   paging_init ();
+#ifdef VM
+  page_init ();
+#endif
 
   /* Segmentation. */
 #ifdef USERPROG
@@ -260,6 +270,12 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-sl"))
+        page_stack_limit = atoi (value);
+      else if (!strcmp (name, "-fa"))
+        page_fault_around = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -382,6 +398,10 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -sl=COUNT          Limit each user stack to COUNT pages.\n"
+          "  -fa=COUNT          Map up to COUNT file pages per page fault.\n"
 #endif
           );
   shutdown_power_off ();
@@ -8,6 +8,10 @@
 #include "threads/palloc.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
+#ifdef MALLOC_PROFILE
+#include "threads/interrupt.h"
+#include "threads/thread.h"
+#endif
 
 /* A simple implementation of malloc().
 
@@ -32,7 +36,12 @@
    because they're too big to fit in a single page with a
    descriptor.  We handle those by allocating contiguous pages
    with the page allocator and sticking the allocation size at
-   the beginning of the allocated block's arena header. */
+   the beginning of the allocated block's arena header.
+
+   If MALLOC_PROFILE is defined, every block also carries a tag
+   recording who allocated it, and live and peak usage is kept
+   per call site; see the profiler code at the end of this
+   file. */
 
 /* Descriptor. */
 struct desc
@@ -66,6 +75,27 @@ static size_t desc_cnt;         /* Number of descriptors. */
 
 static struct arena *block_to_arena (struct block *);
 static struct block *arena_to_block (struct arena *, size_t idx);
+static void *block_alloc (size_t);
+static void block_free (void *);
+static size_t block_size (void *);
+
+#ifdef MALLOC_PROFILE
+static void profile_init (void);
+static void *profile_alloc (size_t, void *caller);
+static void profile_free (void *);
+static size_t profile_size (void *);
+
+/* Allocation entry points go through the profiler, which is told
+   the address that malloc(), calloc() or realloc() will return
+   to. */
+#define ALLOC(SIZE) profile_alloc (SIZE, __builtin_return_address (0))
+#define FREE(P) profile_free (P)
+#define SIZE(P) profile_size (P)
+#else
+#define ALLOC(SIZE) block_alloc (SIZE)
+#define FREE(P) block_free (P)
+#define SIZE(P) block_size (P)
+#endif
 
 /* Initializes the malloc() descriptors. */
 void
@@ -82,12 +112,24 @@ malloc_init (void)
       list_init (&d->free_list);
       lock_init (&d->lock);
     }
+#ifdef MALLOC_PROFILE
+  profile_init ();
+#endif
 }
 
 /* Obtains and returns a new block of at least SIZE bytes.
    Returns a null pointer if memory is not available. */
 void *
 malloc (size_t size) 
+{
+  return ALLOC (size);
+}
+
+/* Obtains and returns a new block of at least SIZE bytes from
+   the descriptors or the page allocator.  Returns a null pointer
+   if memory is not available. */
+static void *
+block_alloc (size_t size) 
 {
   struct desc *d;
   struct block *b;
@@ -169,7 +211,7 @@ calloc (size_t a, size_t b)
     return NULL;
 
   /* Allocate and zero memory. */
-  p = malloc (size);
+  p = ALLOC (size);
   if (p != NULL)
     memset (p, 0, size);
 
@@ -203,13 +245,13 @@ realloc (void *old_block, size_t new_size)
     }
   else 
     {
-      void *new_block = malloc (new_size);
+      void *new_block = ALLOC (new_size);
       if (old_block != NULL && new_block != NULL)
         {
-          size_t old_size = block_size (old_block);
+          size_t old_size = SIZE (old_block);
           size_t min_size = new_size < old_size ? new_size : old_size;
           memcpy (new_block, old_block, min_size);
-          free (old_block);
+          FREE (old_block);
         }
       return new_block;
     }
@@ -219,6 +261,14 @@ realloc (void *old_block, size_t new_size)
    malloc(), calloc(), or realloc(). */
 void
 free (void *p) 
+{
+  FREE (p);
+}
+
+/* Frees block P, which must have been obtained from
+   block_alloc(). */
+static void
+block_free (void *p) 
 {
   if (p != NULL)
     {
@@ -294,3 +344,222 @@ arena_to_block (struct arena *a, size_t idx)
                            + sizeof *a
                            + idx * a->desc->block_size);
 }
+
+#ifdef MALLOC_PROFILE
+/* Allocation profiler.
+
+   Each block is preceded by a tag naming the call site that
+   allocated it (the return address of malloc(), calloc() or
+   realloc()), the size requested and the allocating thread.
+   Tags of live blocks are kept on a list, so that blocks still
+   live at process exit or shutdown can be reported, and each
+   call site has an entry in a small open-addressed table with
+   its live and peak bytes.
+
+   The bookkeeping is a hash probe and a list insertion or
+   removal per call, done with interrupts off so that it is safe
+   wherever malloc() is. */
+
+/* Number of call sites tracked.  Sites beyond this are lumped
+   together under a null caller. */
+#define PROFILE_SITES 256
+
+/* Number of call sites to print at shutdown. */
+#define PROFILE_TOP 10
+
+/* Most live blocks to list in a report. */
+#define PROFILE_LIST_MAX 20
+
+/* Per-block tag.  Its size is a multiple of TAG_ALIGN, so that
+   the part of a block handed to the caller is aligned just as the
+   whole block would be without profiling. */
+#define TAG_ALIGN 16
+struct tag
+  {
+    struct list_elem elem;      /* Element in `live_blocks'. */
+    void *caller;               /* Allocating call site. */
+    size_t size;                /* Bytes requested. */
+    tid_t tid;                  /* Allocating thread. */
+    uint32_t pad[3];            /* Rounds size up to 32 bytes. */
+  };
+
+/* Per-call-site statistics. */
+struct site
+  {
+    void *caller;               /* Call site, null if unused. */
+    size_t live_cnt;            /* Blocks now allocated. */
+    size_t live_bytes;          /* Bytes now allocated. */
+    size_t peak_bytes;          /* Most bytes ever allocated at once. */
+    unsigned long long alloc_cnt; /* Blocks allocated, ever. */
+  };
+
+static struct site sites[PROFILE_SITES];
+static struct site overflow_site;
+static struct list live_blocks;
+
+/* Initializes the profiler. */
+static void
+profile_init (void)
+{
+  /* If this assertion fails, adjust `pad' in struct tag. */
+  ASSERT (sizeof (struct tag) % TAG_ALIGN == 0);
+
+  list_init (&live_blocks);
+}
+
+/* Returns the site entry for CALLER, making one if needed.
+   Interrupts must be off. */
+static struct site *
+find_site (void *caller)
+{
+  size_t i = ((uintptr_t) caller >> 2) % PROFILE_SITES;
+  size_t probes;
+
+  for (probes = 0; probes < PROFILE_SITES; probes++)
+    {
+      struct site *s = &sites[i];
+      if (s->caller == caller)
+        return s;
+      if (s->caller == NULL)
+        {
+          s->caller = caller;
+          return s;
+        }
+      i = (i + 1) % PROFILE_SITES;
+    }
+  return &overflow_site;
+}
+
+/* Allocates a tagged block of SIZE bytes on behalf of CALLER. */
+static void *
+profile_alloc (size_t size, void *caller)
+{
+  struct tag *t;
+  struct site *s;
+  enum intr_level old_level;
+
+  if (size == 0 || size + sizeof *t < size)
+    return NULL;
+  t = block_alloc (size + sizeof *t);
+  if (t == NULL)
+    return NULL;
+  t->caller = caller;
+  t->size = size;
+  t->tid = thread_current ()->tid;
+
+  old_level = intr_disable ();
+  list_push_back (&live_blocks, &t->elem);
+  s = find_site (caller);
+  s->alloc_cnt++;
+  s->live_cnt++;
+  s->live_bytes += size;
+  if (s->live_bytes > s->peak_bytes)
+    s->peak_bytes = s->live_bytes;
+  intr_set_level (old_level);
+
+  return t + 1;
+}
+
+/* Frees tagged block P. */
+static void
+profile_free (void *p)
+{
+  struct tag *t;
+  struct site *s;
+  enum intr_level old_level;
+
+  if (p == NULL)
+    return;
+  t = (struct tag *) p - 1;
+
+  old_level = intr_disable ();
+  list_remove (&t->elem);
+  s = find_site (t->caller);
+  s->live_cnt--;
+  s->live_bytes -= t->size;
+  intr_set_level (old_level);
+
+  block_free (t);
+}
+
+/* Returns the number of bytes requested for tagged block P. */
+static size_t
+profile_size (void *p)
+{
+  struct tag *t = (struct tag *) p - 1;
+  ASSERT (t->size + sizeof *t <= block_size (t));
+  return t->size;
+}
+
+/* Prints the live blocks allocated by thread TID, or by any
+   thread if TID is TID_ERROR, under the heading WHEN. */
+static void
+print_live (tid_t tid, const char *when)
+{
+  struct list_elem *e;
+  enum intr_level old_level;
+  size_t cnt = 0, bytes = 0;
+
+  old_level = intr_disable ();
+  for (e = list_begin (&live_blocks); e != list_end (&live_blocks);
+       e = list_next (e))
+    {
+      struct tag *t = list_entry (e, struct tag, elem);
+      if (tid != TID_ERROR && t->tid != tid)
+        continue;
+      if (cnt++ < PROFILE_LIST_MAX)
+        printf ("malloc: live at %s: %zu bytes at %p from %p (tid %d)\n",
+                when, t->size, t + 1, t->caller, t->tid);
+      bytes += t->size;
+    }
+  intr_set_level (old_level);
+
+  if (cnt > 0)
+    printf ("malloc: %zu blocks, %zu bytes live at %s\n", cnt, bytes, when);
+}
+
+/* Prints the blocks that thread TID allocated and has not
+   freed, as it exits. */
+void
+malloc_print_leaks (tid_t tid)
+{
+  print_live (tid, "exit");
+}
+
+/* Prints the PROFILE_TOP call sites with the most bytes ever
+   live at once, followed by every block still live. */
+void
+malloc_print_profile (void)
+{
+  static struct site top[PROFILE_TOP];
+  enum intr_level old_level;
+  size_t top_cnt = 0;
+  size_t i, j;
+
+  /* Insertion sort by peak into TOP. */
+  old_level = intr_disable ();
+  for (i = 0; i <= PROFILE_SITES; i++)
+    {
+      struct site *s = i < PROFILE_SITES ? &sites[i] : &overflow_site;
+      if (s->alloc_cnt == 0)
+        continue;
+      for (j = top_cnt; j > 0 && top[j - 1].peak_bytes < s->peak_bytes; j--)
+        if (j < PROFILE_TOP)
+          top[j] = top[j - 1];
+      if (j < PROFILE_TOP)
+        {
+          top[j] = *s;
+          if (top_cnt < PROFILE_TOP)
+            top_cnt++;
+        }
+    }
+  intr_set_level (old_level);
+
+  printf ("malloc: top %zu call sites by peak bytes:\n", top_cnt);
+  for (i = 0; i < top_cnt; i++)
+    printf ("  %p: %zu peak, %zu live in %zu blocks, %llu allocations\n",
+            top[i].caller, top[i].peak_bytes, top[i].live_bytes,
+            top[i].live_cnt, top[i].alloc_cnt);
+  print_live (TID_ERROR, "shutdown");
+}
+#endif /* MALLOC_PROFILE */
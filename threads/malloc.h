@@ -10,4 +10,11 @@ void *calloc (size_t, size_t) __attribute__ ((malloc));
 void *realloc (void *, size_t);
 void free (void *);
 
+#ifdef MALLOC_PROFILE
+/* Allocation profiler, built in with -DMALLOC_PROFILE. */
+#include "threads/thread.h"
+void malloc_print_leaks (tid_t);
+void malloc_print_profile (void);
+#endif
+
 #endif /* threads/malloc.h */
@@ -10,12 +10,15 @@
 #include <bitmap.h>
 #include <debug.h>
 #include <inttypes.h>
+#include <list.h>
 #include <round.h>
 #include <stddef.h>
 #include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include "threads/interrupt.h"
 #include "threads/loader.h"
+#include "threads/shrink.h"
 #include "threads/vaddr.h"
 
 /* Page allocator.  Hands out memory in page-size (or
@@ -30,13 +33,43 @@
 
    By default, half of system RAM is given to the kernel pool and
    half to the user pool.  That should be huge overkill for the
-   kernel pool, but that's just fine for demonstration purposes. */
+   kernel pool, but that's just fine for demonstration purposes.
 
+   The kernel pool is managed as a binary buddy system: free
+   memory is kept as blocks of 2**ORDER pages, aligned to their
+   own size, on one free list per order.  Allocating N pages
+   splits the smallest large-enough block and gives back the
+   unused tail, and freeing merges a block with its buddy for as
+   long as the buddy is free too, so both take time logarithmic
+   in the pool size rather than linear.  The user pool is carved
+   up once, by the frame table, and so keeps the plain bitmap. */
 
+/* Number of buddy orders: blocks of up to 2**15 pages. */
+#define BUDDY_ORDERS 16
+
+/* Buddy allocator state for a pool. */
+struct buddy
+  {
+    uint8_t *base;                      /* Base of pool. */
+    size_t page_cnt;                    /* Number of pages in pool. */
+    int8_t *order;                      /* Per page: order of free block
+                                           starting there, or -1. */
+    struct list free[BUDDY_ORDERS];     /* Free blocks, by order. */
+    size_t free_cnt[BUDDY_ORDERS];      /* Number of blocks in each list. */
+    size_t free_pages;                  /* Total free pages. */
+    size_t fail_cnt;                    /* Allocations that failed. */
+  };
 
 /* Two pools: one for kernel data, one for user pages. */
 static struct pool kernel_pool, user_pool;
 
+/* Buddy allocator for the kernel pool. */
+static struct buddy kernel_buddy;
+
+static void buddy_init (struct buddy *, struct pool *);
+static size_t buddy_alloc (struct buddy *, size_t page_cnt);
+static void buddy_free (struct buddy *, size_t page_idx, size_t page_cnt);
+
 /* Initializes the page allocator.  At most USER_PAGE_LIMIT
    pages are put into the user pool. */
 int
@@ -56,6 +89,7 @@ old_palloc_init (size_t user_page_limit)
   init_pool (&kernel_pool, free_start, kernel_pages, "kernel pool");
   init_pool (&user_pool, free_start + kernel_pages * PGSIZE,
              user_pages, "user pool");
+  buddy_init (&kernel_buddy, &kernel_pool);
 //  printf("in palloc_init: %u user_pages\n", user_pages);
 //  printf("in palloc_init: %u kernel_pages \n", kernel_pages);
   return user_pages;
@@ -78,10 +112,36 @@ old_palloc_get_multiple (enum palloc_flags flags, size_t page_cnt)
   if (page_cnt == 0)
     return NULL;
 
-  lock_acquire (&pool->lock);
-  page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
- // printf("page_idx = %u pool =  %d page count = %d\n", page_idx, (flags & PAL_USER), page_cnt);
-  lock_release (&pool->lock);
+  if (pool == &kernel_pool)
+    {
+      /* The kernel pool is freed from thread_schedule_tail(),
+         where we cannot block on a lock, so it is protected by
+         disabling interrupts instead.  If it is exhausted, ask
+         the shrinkers for memory and try again, for as long as
+         they make progress.  Pages they free need not be
+         contiguous, so one round may not be enough. */
+      for (;;)
+        {
+          enum intr_level old_level = intr_disable ();
+          page_idx = buddy_alloc (&kernel_buddy, page_cnt);
+          if (page_idx != BITMAP_ERROR)
+            {
+              ASSERT (bitmap_none (pool->used_map, page_idx, page_cnt));
+              bitmap_set_multiple (pool->used_map, page_idx, page_cnt,
+                                   true);
+            }
+          intr_set_level (old_level);
+
+          if (page_idx != BITMAP_ERROR || shrinker_reclaim (false, page_cnt) == 0)
+            break;
+        }
+    }
+  else
+    {
+      lock_acquire (&pool->lock);
+      page_idx = bitmap_scan_and_flip (pool->used_map, 0, page_cnt, false);
+      lock_release (&pool->lock);
+    }
 
   if (page_idx != BITMAP_ERROR)
     pages = pool->base + PGSIZE * page_idx;
@@ -126,8 +186,55 @@ old_palloc_free_multiple (void *pages, size_t page_cnt)
   memset (pages, 0xcc, PGSIZE * page_cnt);
 #endif
 
-  ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
-  bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+  if (pool == &kernel_pool)
+    {
+      enum intr_level old_level = intr_disable ();
+      ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+      buddy_free (&kernel_buddy, page_idx, page_cnt);
+      intr_set_level (old_level);
+    }
+  else
+    {
+      ASSERT (bitmap_all (pool->used_map, page_idx, page_cnt));
+      bitmap_set_multiple (pool->used_map, page_idx, page_cnt, false);
+    }
+}
+
+/* Prints the free blocks of the kernel pool by order, as a
+   measure of its fragmentation. */
+void
+old_palloc_print_stats (void)
+{
+  struct buddy *b = &kernel_buddy;
+  enum intr_level old_level;
+  size_t free_cnt[BUDDY_ORDERS];
+  size_t free_pages, fail_cnt, blocks;
+  int largest, order;
+
+  old_level = intr_disable ();
+  memcpy (free_cnt, b->free_cnt, sizeof free_cnt);
+  free_pages = b->free_pages;
+  fail_cnt = b->fail_cnt;
+  intr_set_level (old_level);
+
+  blocks = 0;
+  largest = -1;
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    if (free_cnt[order] > 0)
+      {
+        blocks += free_cnt[order];
+        largest = order;
+      }
+
+  printf ("Kernel pool: %zu of %zu pages free in %zu blocks, "
+          "largest %zu pages, %zu failed allocations\n",
+          free_pages, b->page_cnt, blocks,
+          largest >= 0 ? (size_t) 1 << largest : 0, fail_cnt);
+  printf ("Kernel pool free blocks by order:");
+  for (order = 0; order <= largest; order++)
+    printf (" %zu", free_cnt[order]);
+  printf ("\n");
 }
 
 /* Initializes pool P as starting at START and ending at END,
@@ -162,3 +269,141 @@ page_from_pool (const struct pool *pool, void *page)
 
   return page_no >= start_page && page_no < end_page;
 }
+
+/* Returns the free list element stored at the start of page
+   PAGE_IDX of B. */
+static struct list_elem *
+buddy_elem (struct buddy *b, size_t page_idx)
+{
+  return (struct list_elem *) (b->base + page_idx * PGSIZE);
+}
+
+/* Adds the block of 2**ORDER pages at PAGE_IDX to B's free
+   lists. */
+static void
+buddy_push (struct buddy *b, size_t page_idx, int order)
+{
+  b->order[page_idx] = order;
+  list_push_front (&b->free[order], buddy_elem (b, page_idx));
+  b->free_cnt[order]++;
+  b->free_pages += (size_t) 1 << order;
+}
+
+/* Removes the free block of 2**ORDER pages at PAGE_IDX from B's
+   free lists. */
+static void
+buddy_remove (struct buddy *b, size_t page_idx, int order)
+{
+  ASSERT (b->order[page_idx] == order);
+  b->order[page_idx] = -1;
+  list_remove (buddy_elem (b, page_idx));
+  b->free_cnt[order]--;
+  b->free_pages -= (size_t) 1 << order;
+}
+
+/* Returns the smallest order whose blocks hold PAGE_CNT
+   pages. */
+static int
+buddy_order (size_t page_cnt)
+{
+  int order = 0;
+  while (((size_t) 1 << order) < page_cnt)
+    order++;
+  return order;
+}
+
+/* Frees the block of 2**ORDER pages at PAGE_IDX in B, merging it
+   with its buddy for as long as the buddy is free. */
+static void
+buddy_free_block (struct buddy *b, size_t page_idx, int order)
+{
+  while (order + 1 < BUDDY_ORDERS)
+    {
+      size_t buddy_idx = page_idx ^ ((size_t) 1 << order);
+      if (buddy_idx >= b->page_cnt || b->order[buddy_idx] != order)
+        break;
+      buddy_remove (b, buddy_idx, order);
+      page_idx &= ~((size_t) 1 << order);
+      order++;
+    }
+  buddy_push (b, page_idx, order);
+}
+
+/* Frees the PAGE_CNT pages starting at PAGE_IDX in B, which need
+   not form a single block, by splitting them into the largest
+   aligned blocks that fit. */
+static void
+buddy_free (struct buddy *b, size_t page_idx, size_t page_cnt)
+{
+  while (page_cnt > 0)
+    {
+      int order = 0;
+      while (order + 1 < BUDDY_ORDERS
+             && page_idx % ((size_t) 2 << order) == 0
+             && ((size_t) 2 << order) <= page_cnt)
+        order++;
+      buddy_free_block (b, page_idx, order);
+      page_idx += (size_t) 1 << order;
+      page_cnt -= (size_t) 1 << order;
+    }
+}
+
+/* Allocates PAGE_CNT contiguous pages from B and returns the
+   index of the first, or BITMAP_ERROR if no free block is large
+   enough.  Only PAGE_CNT pages are used: the rest of the block
+   goes straight back to the free lists. */
+static size_t
+buddy_alloc (struct buddy *b, size_t page_cnt)
+{
+  int want = buddy_order (page_cnt);
+  int order;
+  size_t page_idx;
+
+  for (order = want; order < BUDDY_ORDERS; order++)
+    if (!list_empty (&b->free[order]))
+      break;
+  if (order >= BUDDY_ORDERS)
+    {
+      b->fail_cnt++;
+      return BITMAP_ERROR;
+    }
+
+  page_idx = pg_no (list_front (&b->free[order])) - pg_no (b->base);
+  buddy_remove (b, page_idx, order);
+  while (order > want)
+    {
+      order--;
+      buddy_push (b, page_idx + ((size_t) 1 << order), order);
+    }
+  buddy_free (b, page_idx + page_cnt, ((size_t) 1 << want) - page_cnt);
+  return page_idx;
+}
+
+/* Initializes B to manage POOL, whose pages must all be free.
+   The per-page order array takes the first pages of POOL, which
+   are marked used for good. */
+static void
+buddy_init (struct buddy *b, struct pool *pool)
+{
+  size_t page_cnt = bitmap_size (pool->used_map);
+  size_t meta_pages = DIV_ROUND_UP (page_cnt, PGSIZE);
+  int order;
+
+  if (meta_pages > page_cnt)
+    PANIC ("Not enough memory in pool for buddy allocator.");
+  bitmap_set_multiple (pool->used_map, 0, meta_pages, true);
+
+  b->base = pool->base;
+  b->page_cnt = page_cnt;
+  b->order = (int8_t *) pool->base;
+  memset (b->order, -1, page_cnt);
+  for (order = 0; order < BUDDY_ORDERS; order++)
+    {
+      list_init (&b->free[order]);
+      b->free_cnt[order] = 0;
+    }
+  b->free_pages = 0;
+  b->fail_cnt = 0;
+
+  buddy_free (b, meta_pages, page_cnt - meta_pages);
+}
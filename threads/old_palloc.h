@@ -25,6 +25,7 @@ void *old_palloc_get_page (enum palloc_flags);
 void *old_palloc_get_multiple (enum palloc_flags, size_t page_cnt);
 void old_palloc_free_page (void *);
 void old_palloc_free_multiple (void *, size_t page_cnt);
+void old_palloc_print_stats (void);
 
 void init_pool (struct pool *, void *base, size_t page_cnt,
                        const char *name);
@@ -22,6 +22,7 @@
 #include <stdio.h>
 #include <string.h>
 #include "threads/loader.h"
+#include "threads/shrink.h"
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/thread.h"
@@ -117,10 +118,29 @@ palloc_page (enum palloc_flags flags, void * upage, bool writable)
    struct pool *pool = &frame_table.frame_pool;
    size_t page_idx;
 
-   // empty page, and set to used
-   lock_acquire (&pool->lock);
-   page_idx = bitmap_scan_and_flip (pool->used_map, 0, 1, false);
-   lock_release (&pool->lock);
+   // empty page, and set to used. if the pool is full, ask the
+   // shrinkers for user frames and try again, for as long as they
+   // make progress
+   for(;;)
+   {
+      lock_acquire (&pool->lock);
+      page_idx = bitmap_scan_and_flip (pool->used_map, 0, 1, false);
+      if (page_idx != BITMAP_ERROR
+          && ++frame_table.used_cnt > frame_table.peak_cnt)
+         frame_table.peak_cnt = frame_table.used_cnt;
+      lock_release (&pool->lock);
+
+      if (page_idx != BITMAP_ERROR || shrinker_reclaim (true, 1) == 0)
+         break;
+   }
+
+   // no free frames left
+   if (page_idx == BITMAP_ERROR)
+   {
+      if (flags & PAL_ASSERT)
+         PANIC ("palloc_get: out of pages");
+      return NULL;
+   }
 
    /* sets the members of cur_frame struct after is it allocated */
    struct frame_entry * cur_frame;
@@ -139,6 +159,7 @@ palloc_page (enum palloc_flags flags, void * upage, bool writable)
    {
       if (flags & PAL_ASSERT)
          PANIC ("palloc_get: out of pages"); // change this?
+      frame_free (cur_frame->kpage);
       return NULL;
    }
    else if (flags & PAL_ZERO)
@@ -175,16 +196,30 @@ void palloc_free_upage(void * page)
 
 /* Frees the PAGE_CNT pages starting at PAGES. */
 void palloc_free_umultiple(void *pages, size_t page_cnt) 
-// NOTE: THIS FUNCTION IS NOT CORRECT!!!
 {
+  uint32_t *pd = thread_current()->pagedir;
   size_t i;
   for(i = 0; i < page_cnt; i++)
   {
-     void * kpage =lookup_page(thread_current()->pagedir, pages + i * PGSIZE, false);
-     palloc_free_page(kpage);
+     void * upage = pages + i * PGSIZE;
+     void * kpage = pagedir_get_page(pd, upage);
+     if(kpage != NULL)
+     {
+        pagedir_clear_page(pd, upage);
+        frame_free(kpage);
+     }
   }
 }
 
+/* Returns the frame at KPAGE, which must be mapped by no page
+   table any more, to the frame table.  Used when tearing down a
+   page directory, where the user page is no longer known. */
+void
+palloc_free_frame (void *kpage)
+{
+  frame_free (kpage);
+}
+
 /* Frees the page at PAGE. */
 void
 palloc_free_page (void *page) 
@@ -192,6 +227,13 @@ palloc_free_page (void *page)
   old_palloc_free_multiple (page, 1);
 }
 
+/* Prints kernel pool fragmentation statistics. */
+void
+palloc_print_stats (void)
+{
+  old_palloc_print_stats ();
+}
+
 /* Adds a mapping from user virtual address UPAGE to kernel
    virtual address KPAGE to the page table.
    If WRITABLE is true, the user process may modify the page;
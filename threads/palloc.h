@@ -13,6 +13,8 @@ void palloc_free_page (void *);
 void palloc_free_multiple (void *, size_t page_cnt);
 void palloc_free_upage (void *);
 void palloc_free_umultiple (void *, size_t page_cnt);
+void palloc_free_frame (void *kpage);
+void palloc_print_stats (void);
 
 
 #endif /* threads/palloc.h */
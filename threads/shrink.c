@@ -0,0 +1,152 @@
+#include "threads/shrink.h"
+#include <debug.h>
+#include <stdio.h>
+#include "threads/interrupt.h"
+#include "threads/synch.h"
+
+/* Memory pressure callbacks.
+
+   Subsystems that hold pages they could give back register a
+   shrinker: the object caches for their reserve slabs, in the
+   kernel pool, and the virtual memory system for user frames
+   that fault-around mapped but nothing has touched, in the user
+   pool.  When a pool cannot satisfy an allocation, the page
+   allocator calls shrinker_reclaim(), which asks that pool's
+   shrinkers in priority order to free pages until enough have
+   been freed, and then retries.  Only when no shrinker can free anything does
+   the allocation fail, or panic for PAL_ASSERT.
+
+   One reclaim runs at a time.  A thread whose allocation fails
+   while another thread is reclaiming waits for it to finish, and
+   then retries its allocation before reclaiming for itself.
+   Reclaim is not reentrant: an allocation that fails inside a
+   shrinker, or in an interrupt handler, fails without
+   reclaiming. */
+
+/* Registered shrinkers, in ascending order of priority. */
+static struct list shrinkers = LIST_INITIALIZER (shrinkers);
+
+/* Held while a reclaim is in progress. */
+static struct lock reclaim_lock;
+
+/* Pages freed by all reclaims so far.  Only changes with
+   `reclaim_lock' held. */
+static size_t freed_total;
+
+/* Statistics. */
+static unsigned long long reclaim_cnt;  /* Calls to shrinker_reclaim(). */
+static unsigned long long short_cnt;    /* Calls that fell short. */
+
+static list_less_func priority_less;
+
+/* Initializes the shrinker registry. */
+void
+shrinker_init (void)
+{
+  lock_init (&reclaim_lock);
+}
+
+/* Adds S, which must remain valid for the life of the kernel, to
+   the registry. */
+void
+shrinker_register (struct shrinker *s)
+{
+  enum intr_level old_level;
+
+  ASSERT (s != NULL);
+  ASSERT (s->shrink != NULL);
+
+  s->call_cnt = 0;
+  s->freed_cnt = 0;
+
+  old_level = intr_disable ();
+  list_insert_ordered (&shrinkers, &s->elem, priority_less, NULL);
+  intr_set_level (old_level);
+}
+
+/* Asks the registered shrinkers for the user pool if USER is
+   true, otherwise for the kernel pool, in priority order, to
+   free PAGE_CNT pages between them.  Returns the number of
+   pages actually freed, which may be more or less than
+   PAGE_CNT.
+
+   If another thread is reclaiming, waits for it to finish.  If
+   it freed any pages, returns that number without reclaiming
+   again, so that the caller retries its allocation first.
+
+   Returns 0 at once if called from an interrupt handler or from
+   within a shrinker, which cannot wait for the reclaim that is
+   already in progress. */
+size_t
+shrinker_reclaim (bool user, size_t page_cnt)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+
+  if (intr_context () || lock_held_by_current_thread (&reclaim_lock))
+    return 0;
+
+  if (!lock_try_acquire (&reclaim_lock))
+    {
+      size_t before = freed_total;
+
+      lock_acquire (&reclaim_lock);
+      if (freed_total != before)
+        {
+          lock_release (&reclaim_lock);
+          return freed_total - before;
+        }
+    }
+
+  /* Shrinkers are only ever added, and only to a list that we
+     walk forward, so `reclaim_lock' is enough here. */
+  for (e = list_begin (&shrinkers);
+       e != list_end (&shrinkers) && freed < page_cnt;
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      size_t n;
+
+      if (s->user != user)
+        continue;
+      n = s->shrink (page_cnt - freed);
+
+      s->call_cnt++;
+      s->freed_cnt += n;
+      freed += n;
+    }
+
+  reclaim_cnt++;
+  if (freed < page_cnt)
+    short_cnt++;
+  freed_total += freed;
+  lock_release (&reclaim_lock);
+  return freed;
+}
+
+/* Prints reclaim statistics. */
+void
+shrinker_print_stats (void)
+{
+  struct list_elem *e;
+
+  printf ("Reclaim: %llu calls, %llu fell short\n", reclaim_cnt, short_cnt);
+  for (e = list_begin (&shrinkers); e != list_end (&shrinkers);
+       e = list_next (e))
+    {
+      struct shrinker *s = list_entry (e, struct shrinker, elem);
+      printf ("Shrinker %s: %llu calls, %llu pages freed\n",
+              s->name, s->call_cnt, s->freed_cnt);
+    }
+}
+
+/* Returns true if shrinker A has a lower priority than B. */
+static bool
+priority_less (const struct list_elem *a_, const struct list_elem *b_,
+               void *aux UNUSED)
+{
+  const struct shrinker *a = list_entry (a_, struct shrinker, elem);
+  const struct shrinker *b = list_entry (b_, struct shrinker, elem);
+
+  return a->priority < b->priority;
+}
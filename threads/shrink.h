@@ -0,0 +1,36 @@
+#ifndef THREADS_SHRINK_H
+#define THREADS_SHRINK_H
+
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Frees up to PAGE_CNT pages that its subsystem can do without,
+   from the kernel pool or the user pool as its shrinker says,
+   and returns the number freed.  May be called from any
+   kernel thread, with interrupts on or off, including one that
+   is in the middle of the subsystem's own code, so it must not
+   sleep and must use lock_try_acquire() rather than
+   lock_acquire(). */
+typedef size_t shrink_func (size_t page_cnt);
+
+/* A subsystem that can give memory back under pressure. */
+struct shrinker
+  {
+    const char *name;           /* Name, for statistics. */
+    int priority;               /* Lower priorities are asked first. */
+    shrink_func *shrink;        /* Callback. */
+    bool user;                  /* Frees user frames, not kernel pages? */
+
+    /* Owned by shrink.c. */
+    struct list_elem elem;      /* Element in registry. */
+    unsigned long long call_cnt; /* Number of calls to `shrink'. */
+    unsigned long long freed_cnt; /* Pages it has freed, in total. */
+  };
+
+void shrinker_init (void);
+void shrinker_register (struct shrinker *);
+size_t shrinker_reclaim (bool user, size_t page_cnt);
+void shrinker_print_stats (void);
+
+#endif /* threads/shrink.h */
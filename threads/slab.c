@@ -0,0 +1,340 @@
+#include "threads/slab.h"
+#include <debug.h>
+#include <list.h>
+#include <round.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include "threads/interrupt.h"
+#include "threads/malloc.h"
+#include "threads/palloc.h"
+#include "threads/shrink.h"
+#include "threads/synch.h"
+#include "threads/vaddr.h"
+
+/* Object caches.
+
+   malloc() rounds every request up to a power of 2 and shares
+   each size class among all of its users.  A cache instead hands
+   out objects of one exact size, for one kind of object, with a
+   lock of its own.
+
+   A cache's memory comes in one-page "slabs".  Each slab starts
+   with a header and a stack of the indexes of its free objects,
+   followed by as many objects as fit.  Because free objects are
+   tracked outside the objects themselves, a freed object keeps
+   the state it was in, so an optional constructor need run only
+   once per object, when its slab is created.
+
+   A cache keeps its slabs on three lists: partially used, fully
+   used, and unused.  Allocation takes from a partially used slab
+   first, so that used objects stay packed into few slabs.  One
+   unused slab is kept in reserve, to avoid going back to the
+   page allocator each time a cache grows and shrinks by a single
+   object; further unused slabs are freed at once.  Under memory
+   pressure, the reserve slabs are given back too. */
+
+/* Magic number for detecting slab corruption. */
+#define SLAB_MAGIC 0x51ab51ab
+
+/* Alignment of objects within a slab. */
+#define OBJ_ALIGN sizeof (void *)
+
+/* An object cache. */
+struct kmem_cache
+  {
+    struct list_elem elem;      /* Element in `all_caches'. */
+    const char *name;           /* Name, for statistics. */
+    size_t obj_size;            /* Size of each object in bytes. */
+    size_t objs_per_slab;       /* Number of objects in a slab. */
+    size_t obj_ofs;             /* Offset of first object in a slab. */
+    kmem_ctor_func *ctor;       /* Constructor, or null. */
+    struct lock lock;           /* Protects all of the below. */
+    struct list partial;        /* Slabs with used and free objects. */
+    struct list full;           /* Slabs with no free objects. */
+    struct list empty;          /* Slabs with no used objects. */
+
+    /* Statistics. */
+    size_t slab_cnt;            /* Slabs allocated. */
+    size_t live_cnt;            /* Objects in use. */
+    size_t peak_cnt;            /* Most objects ever in use at once. */
+    unsigned long long alloc_cnt; /* Objects allocated, ever. */
+  };
+
+/* A slab.  Lives at the start of its page. */
+struct slab
+  {
+    unsigned magic;             /* Always set to SLAB_MAGIC. */
+    struct kmem_cache *cache;   /* Owning cache. */
+    struct list_elem elem;      /* Element in one of the cache's lists. */
+    size_t free_cnt;            /* Number of free objects. */
+    uint16_t free[];            /* Indexes of free objects. */
+  };
+
+/* All caches, for statistics. */
+static struct list all_caches = LIST_INITIALIZER (all_caches);
+
+/* Gives reserve slabs back when the kernel pool runs dry.  They
+   cost nothing to rebuild, so ask early. */
+static shrink_func kmem_shrink;
+static struct shrinker kmem_shrinker =
+  { .name = "slab", .priority = 0, .shrink = kmem_shrink, .user = false };
+
+static struct slab *new_slab (struct kmem_cache *);
+static struct slab *obj_to_slab (struct kmem_cache *, void *);
+static void *slab_obj (struct kmem_cache *, struct slab *, size_t idx);
+
+/* Initializes the object cache subsystem. */
+void
+kmem_init (void)
+{
+  shrinker_register (&kmem_shrinker);
+}
+
+/* Creates and returns a cache of SIZE-byte objects named NAME,
+   which must remain valid for the life of the cache.  If CTOR is
+   non-null, it is called on each object when the object is
+   created.  Returns a null pointer if memory is not available.
+   SIZE must leave room for at least one object in a page. */
+struct kmem_cache *
+kmem_cache_create (const char *name, size_t size, kmem_ctor_func *ctor)
+{
+  struct kmem_cache *c;
+  enum intr_level old_level;
+  size_t n;
+
+  ASSERT (size > 0);
+
+  c = malloc (sizeof *c);
+  if (c == NULL)
+    return NULL;
+
+  c->name = name;
+  c->obj_size = ROUND_UP (size, OBJ_ALIGN);
+  c->ctor = ctor;
+
+  /* Fit as many objects, plus their free stack entries, into a
+     page as we can. */
+  n = (PGSIZE - sizeof (struct slab)) / (c->obj_size + sizeof (uint16_t));
+  while (n > 0
+         && (ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                       OBJ_ALIGN)
+             + n * c->obj_size) > PGSIZE)
+    n--;
+  ASSERT (n > 0);
+  c->objs_per_slab = n;
+  c->obj_ofs = ROUND_UP (sizeof (struct slab) + n * sizeof (uint16_t),
+                         OBJ_ALIGN);
+
+  lock_init (&c->lock);
+  list_init (&c->partial);
+  list_init (&c->full);
+  list_init (&c->empty);
+  c->slab_cnt = 0;
+  c->live_cnt = 0;
+  c->peak_cnt = 0;
+  c->alloc_cnt = 0;
+
+  old_level = intr_disable ();
+  list_push_back (&all_caches, &c->elem);
+  intr_set_level (old_level);
+
+  return c;
+}
+
+/* Obtains and returns an object from cache C.  Returns a null
+   pointer if memory is not available. */
+void *
+kmem_cache_alloc (struct kmem_cache *c)
+{
+  struct slab *s;
+  void *obj;
+
+  lock_acquire (&c->lock);
+
+  /* Find a slab with a free object, making one if need be. */
+  if (!list_empty (&c->partial))
+    s = list_entry (list_front (&c->partial), struct slab, elem);
+  else
+    {
+      if (!list_empty (&c->empty))
+        s = list_entry (list_pop_front (&c->empty), struct slab, elem);
+      else
+        {
+          s = new_slab (c);
+          if (s == NULL)
+            {
+              lock_release (&c->lock);
+              return NULL;
+            }
+        }
+      list_push_front (&c->partial, &s->elem);
+    }
+
+  /* Take an object from it. */
+  obj = slab_obj (c, s, s->free[--s->free_cnt]);
+  if (s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->full, &s->elem);
+    }
+
+  c->alloc_cnt++;
+  if (++c->live_cnt > c->peak_cnt)
+    c->peak_cnt = c->live_cnt;
+
+  lock_release (&c->lock);
+  return obj;
+}
+
+/* Returns OBJ, which must have been obtained from cache C with
+   kmem_cache_alloc(), to C.  OBJ may be a null pointer. */
+void
+kmem_cache_free (struct kmem_cache *c, void *obj)
+{
+  struct slab *s;
+  size_t idx;
+
+  if (obj == NULL)
+    return;
+
+  s = obj_to_slab (c, obj);
+  idx = ((uint8_t *) obj - ((uint8_t *) s + c->obj_ofs)) / c->obj_size;
+
+#ifndef NDEBUG
+  /* Clear the object to help detect use-after-free bugs, unless
+     its constructed state must be kept. */
+  if (c->ctor == NULL)
+    memset (obj, 0xcc, c->obj_size);
+#endif
+
+  lock_acquire (&c->lock);
+
+  ASSERT (s->free_cnt < c->objs_per_slab);
+  if (s->free_cnt == 0)
+    {
+      list_remove (&s->elem);
+      list_push_front (&c->partial, &s->elem);
+    }
+  s->free[s->free_cnt++] = idx;
+  c->live_cnt--;
+
+  /* Keep one unused slab in reserve and free the others. */
+  if (s->free_cnt == c->objs_per_slab)
+    {
+      list_remove (&s->elem);
+      if (list_empty (&c->empty))
+        list_push_front (&c->empty, &s->elem);
+      else
+        {
+          s->magic = 0;
+          c->slab_cnt--;
+          palloc_free_page (s);
+        }
+    }
+
+  lock_release (&c->lock);
+}
+
+/* Prints statistics for every cache. */
+void
+kmem_print_stats (void)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (&all_caches); e != list_end (&all_caches);
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+      printf ("Slab cache %s: %zu-byte objects, %zu per slab, %zu slabs, "
+              "%zu live (peak %zu), %llu allocations\n",
+              c->name, c->obj_size, c->objs_per_slab, c->slab_cnt,
+              c->live_cnt, c->peak_cnt, c->alloc_cnt);
+    }
+}
+
+/* Frees up to PAGE_CNT unused slabs, from any caches whose locks
+   are free, and returns the number freed. */
+static size_t
+kmem_shrink (size_t page_cnt)
+{
+  struct list_elem *e;
+  size_t freed = 0;
+
+  for (e = list_begin (&all_caches);
+       e != list_end (&all_caches) && freed < page_cnt;
+       e = list_next (e))
+    {
+      struct kmem_cache *c = list_entry (e, struct kmem_cache, elem);
+
+      /* The thread that ran out of memory may be inside this very
+         cache, holding its lock, or another thread may hold it, so
+         don't wait for the lock. */
+      if (lock_held_by_current_thread (&c->lock)
+          || !lock_try_acquire (&c->lock))
+        continue;
+      while (!list_empty (&c->empty) && freed < page_cnt)
+        {
+          struct slab *s = list_entry (list_pop_front (&c->empty),
+                                       struct slab, elem);
+          s->magic = 0;
+          c->slab_cnt--;
+          palloc_free_page (s);
+          freed++;
+        }
+      lock_release (&c->lock);
+    }
+  return freed;
+}
+
+/* Allocates a slab for cache C, runs C's constructor on each of
+   its objects, and returns it, or a null pointer if memory is
+   not available.  The slab is on none of C's lists. */
+static struct slab *
+new_slab (struct kmem_cache *c)
+{
+  struct slab *s;
+  size_t i;
+
+  s = palloc_get_page (0);
+  if (s == NULL)
+    return NULL;
+
+  s->magic = SLAB_MAGIC;
+  s->cache = c;
+  s->free_cnt = c->objs_per_slab;
+  for (i = 0; i < c->objs_per_slab; i++)
+    {
+      /* Hand out low addresses first. */
+      s->free[i] = c->objs_per_slab - 1 - i;
+      if (c->ctor != NULL)
+        c->ctor (slab_obj (c, s, i));
+    }
+  c->slab_cnt++;
+  return s;
+}
+
+/* Returns the slab of cache C that OBJ is in. */
+static struct slab *
+obj_to_slab (struct kmem_cache *c, void *obj)
+{
+  struct slab *s = pg_round_down (obj);
+
+  /* Check that the slab is valid. */
+  ASSERT (s->magic == SLAB_MAGIC);
+  ASSERT (s->cache == c);
+
+  /* Check that the object is properly aligned for the slab. */
+  ASSERT (pg_ofs (obj) >= c->obj_ofs);
+  ASSERT ((pg_ofs (obj) - c->obj_ofs) % c->obj_size == 0);
+
+  return s;
+}
+
+/* Returns the IDX'th object within slab S of cache C. */
+static void *
+slab_obj (struct kmem_cache *c, struct slab *s, size_t idx)
+{
+  ASSERT (idx < c->objs_per_slab);
+  return (uint8_t *) s + c->obj_ofs + idx * c->obj_size;
+}
@@ -13,10 +13,14 @@
 #include "threads/synch.h"
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 //#include "vm/frame.h"
 #ifdef USERPROG
 #include "userprog/process.h"
 #endif
+#ifdef FILESYS
+#include "filesys/directory.h"
+#endif
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -40,6 +44,9 @@ static struct thread *initial_thread;
 /* Lock used by allocate_tid(). */
 static struct lock tid_lock;
 
+/* Cache of tid_status nodes. */
+static struct kmem_cache *tid_status_cache;
+
 /* Stack frame for kernel_thread(). */
 struct kernel_thread_frame 
   {
@@ -99,6 +106,13 @@ get_thread_by_tid(tid_t tid)
       return NULL;
 }
 
+/* frees a tid_status allocated by thread_create() */
+void
+free_tid_node(struct tid_status *node)
+{
+   kmem_cache_free(tid_status_cache, node);
+}
+
 /* searches through a threads child_nodes list to find the tid_status w/tid */
 struct tid_status *
 get_node_by_tid(tid_t tid)
@@ -161,6 +175,12 @@ thread_init (void)
 void
 thread_start (void) 
 {
+  /* Every thread_create() allocates a tid_status from here. */
+  tid_status_cache = kmem_cache_create ("tid_status",
+                                        sizeof (struct tid_status), NULL);
+  if (tid_status_cache == NULL)
+    PANIC ("could not create tid_status cache");
+
   /* Create the idle thread. */
   struct semaphore idle_started;
   sema_init (&idle_started, 0);
@@ -243,7 +263,7 @@ thread_create (const char *name, int priority,
   tid = t->tid = allocate_tid ();
  
   // Initialize the tid_node for the thread
-  t->tid_node = malloc(sizeof(struct tid_status));
+  t->tid_node = kmem_cache_alloc(tid_status_cache);
   t->tid_node->tid = t->tid;
   t->tid_node->exit_status = -2; // flags that the status code has not been set
   t->tid_node->loaded = 0;       
@@ -251,6 +271,12 @@ thread_create (const char *name, int priority,
   t->tid_node->child = t;        
   sema_init(&t->tid_node->sema, 0);
   t->tid_node_exists = true;  
+
+#ifdef FILESYS
+  /* Start in the creator's working directory. */
+  if (thread_current ()->cwd != NULL)
+    t->cwd = dir_reopen (thread_current ()->cwd);
+#endif
  
   /* Prepare thread for first run by initializing its stack.
      Do this atomically so intermediate values for the 'stack' 
@@ -547,6 +573,10 @@ init_thread (struct thread *t, const char *name, int priority)
   list_init(&t->fd_list);
   list_init(&t->child_nodes);
   sema_init(&t->load_sema, 0);
+#ifdef VM
+  list_init(&t->mappings);
+  range_init(&t->mapped);
+#endif
 }
 
 /* Allocates a SIZE-byte frame at the top of thread T's stack and
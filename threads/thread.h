@@ -7,6 +7,10 @@
 #include <stdio.h>
 #include "filesys/filesys.h"
 #include "threads/synch.h"
+#ifdef VM
+#include <hash.h>
+#include <rangetree.h>
+#endif
 
 
 
@@ -128,6 +132,20 @@ struct thread
     struct list child_nodes;            /* list of all child tid_status nodes*/
 #endif
 
+#ifdef FILESYS
+    /* Owned by filesys/filesys.c. */
+    struct dir *cwd;                    /* Working directory, null if root. */
+#endif
+
+#ifdef VM
+    /* Owned by vm/page.c and vm/mmap.c. */
+    struct hash pages;                  /* Supplemental page table. */
+    struct list mappings;               /* Memory-mapped files. */
+    struct range_tree mapped;           /* Address ranges of `mappings'. */
+    int next_mapid;                     /* mapid of next mmap. */
+    void *user_esp;                     /* User %esp on syscall entry. */
+#endif
+
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -171,6 +189,7 @@ int thread_get_load_avg (void);
 /*Our helper function, sued to */
 struct thread *get_thread_by_tid(tid_t tid);
 struct tid_status *get_node_by_tid(tid_t tid);
+void free_tid_node(struct tid_status *node);
 
 /* Used to track open file descriptors for a given thread.
  * A node will be created for each open file for a given thread and will persist
@@ -182,6 +201,7 @@ struct fd_elem
    off_t file_size;
    char *filename;
    struct file *the_file;
+   struct dir *dir;             /* the directory, if the file is one */
 };
 
 
@@ -4,6 +4,10 @@
 #include "userprog/gdt.h"
 #include "threads/interrupt.h"
 #include "threads/thread.h"
+#include "threads/vaddr.h"
+#ifdef VM
+#include "vm/page.h"
+#endif
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -148,9 +152,28 @@ page_fault (struct intr_frame *f)
   write = (f->error_code & PF_W) != 0;
   user = (f->error_code & PF_U) != 0;
 
-  /* To implement virtual memory, delete the rest of the function
-     body, and replace it with code that brings in the page to
-     which fault_addr refers. */
+#ifdef VM
+  /* Bring in the page if the supplemental page table knows
+     about it, or grow the stack if the access is close enough to
+     the stack pointer.  This also covers kernel accesses to user
+     memory made on a process's behalf, e.g. by system calls, in
+     which case F->esp is the kernel's and the user's was saved on
+     entry to the system call. */
+  if (not_present && is_user_vaddr (fault_addr))
+    {
+      void *esp = user ? f->esp : thread_current ()->user_esp;
+      if (page_load (fault_addr, write)
+          || page_grow_stack (fault_addr, esp))
+        return;
+    }
+
+  /* A write to a zero-fill page that so far has only been read
+     hits the read-only shared zero frame: copy it on write. */
+  if (!not_present && write && is_user_vaddr (fault_addr)
+      && page_unshare (fault_addr))
+    return;
+#endif
+
   printf ("Page fault at %p: %s error %s page in %s context.\n",
           fault_addr,
           not_present ? "not present" : "rights violation",
@@ -9,6 +9,8 @@
 
 static uint32_t *active_pd (void);
 static void invalidate_pagedir (uint32_t *);
+static void invalidate_page (uint32_t *, const void *);
+static bool clear_pte_bits (uint32_t *pd, const void *vpage, uint32_t bits);
 
 /* Creates a new page directory that has mappings for kernel
    virtual addresses, but none for user virtual addresses.
@@ -35,17 +37,19 @@ pagedir_destroy (uint32_t *pd)
     return;
 
   ASSERT (pd != init_page_dir);
-  /*for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
+  for (pde = pd; pde < pd + pd_no (PHYS_BASE); pde++)
     if (*pde & PTE_P) 
       {
         uint32_t *pt = pde_get_pt (*pde);
         uint32_t *pte;
         
+        /* User pages live in frames, page tables in the kernel
+           pool. */
         for (pte = pt; pte < pt + PGSIZE / sizeof *pte; pte++)
           if (*pte & PTE_P) 
-            palloc_free_page (pte_get_page (*pte));
+            palloc_free_frame (pte_get_page (*pte));
         palloc_free_page (pt);
-      }*/
+      }
   palloc_free_page (pd);
 }
 
@@ -146,17 +150,11 @@ pagedir_get_page (uint32_t *pd, const void *uaddr)
 void
 pagedir_clear_page (uint32_t *pd, void *upage) 
 {
-  uint32_t *pte;
-
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (is_user_vaddr (upage));
 
-  pte = lookup_page (pd, upage, false);
-  if (pte != NULL && (*pte & PTE_P) != 0)
-    {
-      *pte &= ~PTE_P;
-      invalidate_pagedir (pd);
-    }
+  if (clear_pte_bits (pd, upage, PTE_P))
+    invalidate_page (pd, upage);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD is dirty,
@@ -175,17 +173,14 @@ pagedir_is_dirty (uint32_t *pd, const void *vpage)
 void
 pagedir_set_dirty (uint32_t *pd, const void *vpage, bool dirty) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  if (pte != NULL) 
+  if (dirty)
     {
-      if (dirty)
+      uint32_t *pte = lookup_page (pd, vpage, false);
+      if (pte != NULL)
         *pte |= PTE_D;
-      else 
-        {
-          *pte &= ~(uint32_t) PTE_D;
-          invalidate_pagedir (pd);
-        }
     }
+  else if (clear_pte_bits (pd, vpage, PTE_D))
+    invalidate_page (pd, vpage);
 }
 
 /* Returns true if the PTE for virtual page VPAGE in PD has been
@@ -204,17 +199,93 @@ pagedir_is_accessed (uint32_t *pd, const void *vpage)
 void
 pagedir_set_accessed (uint32_t *pd, const void *vpage, bool accessed) 
 {
-  uint32_t *pte = lookup_page (pd, vpage, false);
-  if (pte != NULL) 
+  if (accessed)
     {
-      if (accessed)
+      uint32_t *pte = lookup_page (pd, vpage, false);
+      if (pte != NULL)
         *pte |= PTE_A;
-      else 
-        {
-          *pte &= ~(uint32_t) PTE_A; 
-          invalidate_pagedir (pd);
-        }
     }
+  else if (clear_pte_bits (pd, vpage, PTE_A))
+    invalidate_page (pd, vpage);
+}
+
+/* Batched TLB invalidation.
+
+   Clearing the accessed bit on every page during a clock sweep,
+   or unmapping a whole region, would otherwise pay for one
+   INVLPG per page.  A batch instead records the pages whose PTEs
+   changed and invalidates them all at once in
+   pagedir_batch_flush().  If more than PAGEDIR_BATCH_MAX pages
+   are pending, it is cheaper to reload CR3 and drop the whole
+   TLB, so the batch stops recording and does that instead. */
+
+/* Starts an empty batch of invalidations for page directory
+   PD. */
+void
+pagedir_batch_init (struct pagedir_batch *b, uint32_t *pd)
+{
+  ASSERT (b != NULL);
+  ASSERT (pd != NULL);
+
+  b->pd = pd;
+  b->cnt = 0;
+}
+
+/* Adds VPAGE to batch B. */
+static void
+batch_add (struct pagedir_batch *b, const void *vpage)
+{
+  if (b->cnt < PAGEDIR_BATCH_MAX)
+    b->pages[b->cnt] = vpage;
+  if (b->cnt <= PAGEDIR_BATCH_MAX)
+    b->cnt++;
+}
+
+/* Like pagedir_clear_page(), but defers the TLB invalidation
+   to pagedir_batch_flush(). */
+void
+pagedir_batch_clear_page (struct pagedir_batch *b, void *upage)
+{
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  if (clear_pte_bits (b->pd, upage, PTE_P))
+    batch_add (b, upage);
+}
+
+/* Like pagedir_set_dirty (B's page directory, VPAGE, false), but
+   defers the TLB invalidation to pagedir_batch_flush(). */
+void
+pagedir_batch_clear_dirty (struct pagedir_batch *b, const void *vpage)
+{
+  if (clear_pte_bits (b->pd, vpage, PTE_D))
+    batch_add (b, vpage);
+}
+
+/* Like pagedir_set_accessed (B's page directory, VPAGE, false),
+   but defers the TLB invalidation to pagedir_batch_flush(). */
+void
+pagedir_batch_clear_accessed (struct pagedir_batch *b, const void *vpage)
+{
+  if (clear_pte_bits (b->pd, vpage, PTE_A))
+    batch_add (b, vpage);
+}
+
+/* Invalidates every TLB entry recorded in batch B, or the whole
+   TLB if too many were recorded, and empties B. */
+void
+pagedir_batch_flush (struct pagedir_batch *b)
+{
+  if (b->cnt > PAGEDIR_BATCH_MAX)
+    invalidate_pagedir (b->pd);
+  else
+    {
+      size_t i;
+
+      for (i = 0; i < b->cnt; i++)
+        invalidate_page (b->pd, b->pages[i]);
+    }
+  b->cnt = 0;
 }
 
 /* Loads page directory PD into the CPU's page directory base
@@ -246,6 +317,20 @@ active_pd (void)
   return ptov (pd);
 }
 
+/* Clears BITS in the PTE for virtual page VPAGE in PD.
+   Returns true if any of BITS were set, in which case the TLB
+   may hold a stale copy of the PTE, false otherwise. */
+static bool
+clear_pte_bits (uint32_t *pd, const void *vpage, uint32_t bits)
+{
+  uint32_t *pte = lookup_page (pd, vpage, false);
+  if (pte == NULL || (*pte & bits) == 0)
+    return false;
+
+  *pte &= ~bits;
+  return true;
+}
+
 /* Seom page table changes can cause the CPU's translation
    lookaside buffer (TLB) to become out-of-sync with the page
    table.  When this happens, we have to "invalidate" the TLB by
@@ -264,3 +349,14 @@ invalidate_pagedir (uint32_t *pd)
       pagedir_activate (pd);
     } 
 }
+
+/* Invalidates the TLB entry for virtual page VPAGE if PD is the
+   active page directory.  Unlike invalidate_pagedir(), this
+   leaves the translations for every other page intact.  See
+   [IA32-v2a] "INVLPG--Invalidate TLB Entry". */
+static void
+invalidate_page (uint32_t *pd, const void *vpage) 
+{
+  if (active_pd () == pd) 
+    asm volatile ("invlpg (%0)" : : "r" (vpage) : "memory");
+}
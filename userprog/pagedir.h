@@ -2,8 +2,23 @@
 #define USERPROG_PAGEDIR_H
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
+/* Maximum number of pages a pagedir_batch invalidates one at a
+   time.  Past this, flushing reloads CR3 instead. */
+#define PAGEDIR_BATCH_MAX 32
+
+/* A set of pages whose TLB entries must be invalidated. */
+struct pagedir_batch
+  {
+    uint32_t *pd;                       /* Page directory. */
+    size_t cnt;                         /* Pages pending, or
+                                           PAGEDIR_BATCH_MAX + 1 if
+                                           the whole TLB must go. */
+    const void *pages[PAGEDIR_BATCH_MAX]; /* Pending pages. */
+  };
+
 uint32_t *pagedir_create (void);
 void pagedir_destroy (uint32_t *pd);
 bool pagedir_set_page (uint32_t *pd, void *upage, void *kpage, bool rw);
@@ -16,4 +31,11 @@ void pagedir_set_accessed (uint32_t *pd, const void *upage, bool accessed);
 void pagedir_activate (uint32_t *pd);
 uint32_t *lookup_page (uint32_t *pd, const void *vaddr, bool create);
 
+void pagedir_batch_init (struct pagedir_batch *, uint32_t *pd);
+void pagedir_batch_clear_page (struct pagedir_batch *, void *upage);
+void pagedir_batch_clear_dirty (struct pagedir_batch *, const void *upage);
+void pagedir_batch_clear_accessed (struct pagedir_batch *,
+                                   const void *upage);
+void pagedir_batch_flush (struct pagedir_batch *);
+
 #endif /* userprog/pagedir.h */
@@ -7,6 +7,7 @@
 #include <string.h>
 #include "userprog/gdt.h"
 #include "userprog/pagedir.h"
+#include "userprog/syscall.h"
 #include "userprog/tss.h"
 #include "filesys/directory.h"
 #include "filesys/file.h"
@@ -18,6 +19,10 @@
 #include "threads/malloc.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 
 
@@ -183,10 +188,11 @@ process_wait (tid_t child_tid)
   sema_down(&child_tid_node->sema); // wait for child to die
   result = child_tid_node->exit_status;
   list_remove(&child_tid_node->elem);
-  free(child_tid_node);
 
-  /* Indicate that child has been waited for */
-  child_tid_node->waiting = 1;
+  /* The node is gone from child_nodes, so a second wait on this
+     child finds nothing and returns -1. Don't touch it after
+     freeing it. */
+  free_tid_node(child_tid_node);
 
   return result;
 }
@@ -217,14 +223,19 @@ process_exit (void)
      if(DBP)printf("closing fd %d\n", cur_fd_node->fd);
 
      lock_acquire(&file_lock);
+     dir_close(cur_fd_node->dir);
      file_close(cur_fd_node->the_file);
      lock_release(&file_lock);
 
      /* clean up waste */
      list_remove(&cur_fd_node->elem);
-     free(cur_fd_node->filename);
-     free(cur_fd_node);
+     free_fd_elem(cur_fd_node);
   }
+
+  /* release the working directory */
+  lock_acquire(&file_lock);
+  filesys_exit();
+  lock_release(&file_lock);
   
 
  
@@ -238,7 +249,7 @@ process_exit (void)
      if(cur_tid_node->child != NULL)
         cur->tid_node->child->tid_node_exists = false;
      list_remove(&cur_tid_node->elem);
-     free(cur_tid_node);
+     free_tid_node(cur_tid_node);
 
   }
   /* signal to non-waiting parent that the thread is about to die */
@@ -253,6 +264,13 @@ process_exit (void)
   pd = cur->pagedir;
   if (pd != NULL) 
     {
+#ifdef VM
+      /* Write back dirty mapped pages while the page directory
+         still records which ones they are. */
+      mmap_unmap_all ();
+      page_table_destroy (&cur->pages);
+#endif
+
       /* Correct ordering here is crucial.  We must set
          cur->pagedir to NULL before switching page directories,
          so that a timer interrupt can't switch back to the
@@ -263,6 +281,11 @@ process_exit (void)
       cur->pagedir = NULL;
       pagedir_activate (NULL);
       pagedir_destroy (pd);
+
+#ifdef MALLOC_PROFILE
+      /* Everything the process allocated should be gone by now. */
+      malloc_print_leaks (cur->tid);
+#endif
     }
 }
 
@@ -366,9 +389,18 @@ load (const char *file_name, void (**eip) (void), void **esp, char **argv, int a
   int i;
 
   /* Allocate and activate page directory. */
+#ifdef VM
+  if (!page_table_init (&t->pages))
+    goto done;
+#endif
   t->pagedir = pagedir_create ();
   if (t->pagedir == NULL) 
-    goto done;
+    {
+#ifdef VM
+      page_table_destroy (&t->pages);
+#endif
+      goto done;
+    }
   process_activate ();
 
   /* Open executable file. Deny write if successful */
@@ -534,6 +566,31 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
    ASSERT (pg_ofs (upage) == 0);
    ASSERT (ofs % PGSIZE == 0);
  
+#ifdef VM
+   /* Record where each page comes from and let the page-fault
+      handler read it in on first touch. */
+   while (read_bytes > 0 || zero_bytes > 0) 
+   {
+      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
+      size_t page_zero_bytes = PGSIZE - page_read_bytes;
+      struct page *p;
+
+      if (page_read_bytes > 0)
+         p = page_add_file (upage, PAGE_FILE, file, ofs, page_read_bytes,
+                            writable);
+      else
+         p = page_add_zero (upage, writable);
+      if (p == NULL)
+         return false;
+
+      /* Advance. */
+      read_bytes -= page_read_bytes;
+      zero_bytes -= page_zero_bytes;
+      ofs += page_read_bytes;
+      upage += PGSIZE;
+   }
+   return true;
+#else
    void * kpage = NULL;
    bool success;
    file_seek (file, ofs);
@@ -567,17 +624,19 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
       upage += PGSIZE;
    }
    return true;
+#endif
 }
 
-/* allows the stack to grow if there isn't enough space
-   for the pages to be allocated */
-static uint8_t * grow_stack(uint8_t *prev)
+/* maps a zeroed, writable stack page at upage. With VM, the page
+   goes in the supplemental page table like the pages the stack
+   later grows into from the page fault handler (page_grow_stack) */
+static bool alloc_stack_page(uint8_t *upage)
 {
-   uint8_t *cur = prev - PGSIZE;
-   if(palloc_page(PAL_USER | PAL_ZERO, cur, true))
-      return cur;
-   else
-      return NULL;
+#ifdef VM
+   return page_add_zero(upage, true) != NULL && page_load(upage, true);
+#else
+   return palloc_page(PAL_USER | PAL_ZERO, upage, true) != NULL;
+#endif
 }
 
 /* Create a minimal stack by mapping a zeroed page at the top of
@@ -601,7 +660,7 @@ setup_stack (void **esp, char ** argv, int argc)
 
   // this code has been changed, no longer need access to a kpage
   uint8_t * upage = ((uint8_t *) PHYS_BASE) - PGSIZE;
-  bool success = palloc_page (PAL_USER | PAL_ZERO, upage, true);
+  bool success = alloc_stack_page (upage);
       if (success)
       {
         // initialize esp
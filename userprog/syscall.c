@@ -10,14 +10,21 @@
 #include "devices/input.h"
 #include "filesys/filesys.h"
 #include "filesys/file.h"
+#include "filesys/directory.h"
+#include "filesys/inode.h"
 #include "threads/synch.h"
 #include "threads/malloc.h"
+#include "threads/slab.h"
 #include "threads/vaddr.h"
+#ifdef VM
+#include "vm/mmap.h"
+#include "vm/page.h"
+#endif
 
 /* Our defines */
-#define NUM_SYSCALLS 20
+#define NUM_SYSCALLS 22
 #define SYSCALL_LOWER SYS_HALT
-#define SYSCALL_UPPER SYS_INUMBER
+#define SYSCALL_UPPER SYS_SYNC
 #define DBP false
 
 /* A lock for synchronizatio of file system access. 
@@ -26,14 +33,23 @@ extern struct lock file_lock;
 
 static void syscall_handler (struct intr_frame *);
 bool valid_ptr(const void * ptr);
+bool valid_buffer(const void * buffer, unsigned size, bool write);
+static bool valid_uaddr(const void * ptr, bool write);
+static struct fd_elem *lookup_fd(int fd);
 
 /* Table for system call function lookeup */
 syscall_wrapper* handler_table[NUM_SYSCALLS];
 
+/* Cache of fd_elems, one per open file descriptor */
+static struct kmem_cache *fd_elem_cache;
+
 void
 syscall_init (void) 
 {
   lock_init(&file_lock);
+  fd_elem_cache = kmem_cache_create("fd_elem", sizeof(struct fd_elem), NULL);
+  if(fd_elem_cache == NULL)
+     PANIC("could not create fd_elem cache");
 
   // initializes handler table for table lookup of sys calls
   handler_table[SYS_HALT] = halt_w;
@@ -50,14 +66,22 @@ syscall_init (void)
   handler_table[SYS_TELL] = tell_w;
   handler_table[SYS_CLOSE] = close_w;
 
-  // need to fix assignments for later projects
+#ifdef VM
+  handler_table[SYS_MMAP] = mmap_w;
+  handler_table[SYS_MUNMAP] = munmap_w;
+#else
   handler_table[SYS_MMAP] = NULL;
   handler_table[SYS_MUNMAP] = NULL;
-  handler_table[SYS_CHDIR] = NULL;
-  handler_table[SYS_MKDIR] = NULL;
-  handler_table[SYS_READDIR] = NULL;
-  handler_table[SYS_ISDIR] = NULL;
-  handler_table[SYS_INUMBER] = NULL;
+#endif
+
+  handler_table[SYS_CHDIR] = chdir_w;
+  handler_table[SYS_MKDIR] = mkdir_w;
+  handler_table[SYS_READDIR] = readdir_w;
+  handler_table[SYS_ISDIR] = isdir_w;
+  handler_table[SYS_INUMBER] = inumber_w;
+
+  handler_table[SYS_FSYNC] = fsync_w;
+  handler_table[SYS_SYNC] = sync_w;
 
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
@@ -76,9 +100,13 @@ syscall_handler (struct intr_frame *f)
   if(DBP) printf ("system call!\n");
 
   void * esp = f->esp;
-  /* Check that esp is valid, kill thread otherwise. */
+#ifdef VM
+  /* Remember user esp, for stack growth on faults in the kernel */
   struct thread *cur = thread_current();
-  if(esp == NULL || is_kernel_vaddr(esp) || pagedir_get_page(cur->pagedir, esp) == NULL)
+  cur->user_esp = esp;
+#endif
+  /* Check that esp is valid, kill thread otherwise. */
+  if(esp == NULL || !valid_ptr(esp))
      thread_exit();
 
   /* Get system call_number */
@@ -202,14 +230,27 @@ uint32_t open_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
       return -1;
    }
    file_size = file_length(the_file);
+   struct dir *dir = NULL;
+   if(inode_is_dir(file_get_inode(the_file)))
+   {
+      /* keep a directory handle for readdir */
+      dir = dir_open(inode_reopen(file_get_inode(the_file)));
+      if(dir == NULL)
+      {
+         file_close(the_file);
+         lock_release(&file_lock);
+         return -1;
+      }
+   }
    lock_release(&file_lock); 
 
    /* create file descriptor node */
    struct thread *cur = thread_current(); 
-   struct fd_elem *fd_cur = malloc(sizeof(struct fd_elem));
+   struct fd_elem *fd_cur = kmem_cache_alloc(fd_elem_cache);
    fd_cur->filename = malloc(15*sizeof(char));
    strlcpy(fd_cur->filename, file_name, 15);
    fd_cur->the_file = the_file;
+   fd_cur->dir = dir;
    fd_cur->fd = (cur->next_fd)++;
    fd_cur->file_size = file_size;
 
@@ -237,7 +278,10 @@ uint32_t filesize_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
         struct fd_elem *cur_file_elem = list_entry (e, struct fd_elem, elem);
         if(cur_file_elem->fd == fd)
         {
-           /* return the file_size if found */
+           /* return the current file size if found, files can grow */
+	   lock_acquire(&file_lock);
+	   cur_file_elem->file_size = file_length(cur_file_elem->the_file);
+	   lock_release(&file_lock);
 	   return cur_file_elem->file_size;
         }
    }
@@ -255,8 +299,8 @@ uint32_t read_w(uint32_t arg1, uint32_t arg2, uint32_t arg3)
    unsigned int size = (unsigned int) arg3;
    uint32_t result;
 
-   /* verify buffer pointer is valid */
-   if(!valid_ptr(buffer))
+   /* verify every page of the buffer is valid */
+   if(!valid_buffer(buffer, size, true))
       thread_exit();  
 
    if(fd == 0) // read from stdin
@@ -282,6 +326,10 @@ uint32_t read_w(uint32_t arg1, uint32_t arg2, uint32_t arg3)
            struct fd_elem *cur_file_elem = list_entry (e, struct fd_elem, elem);
            if(cur_file_elem->fd == fd)
            {
+              /* directories are read with readdir */
+              if(cur_file_elem->dir != NULL)
+                 return -1;
+
               /* read from the file if found */
 	      lock_acquire(&file_lock);   
 	      result = (uint32_t) file_read (cur_file_elem->the_file, buffer, size); 
@@ -305,8 +353,8 @@ uint32_t write_w(uint32_t arg1, uint32_t arg2, uint32_t arg3)
    unsigned int size = (unsigned int) arg3;
    uint32_t result;
  
-   /* verify buffer pointer is valid */
-   if(!valid_ptr(buffer))
+   /* verify every page of the buffer is valid */
+   if(!valid_buffer(buffer, size, false))
       thread_exit();
 
    if(fd == 1) // write to stdout
@@ -330,6 +378,10 @@ uint32_t write_w(uint32_t arg1, uint32_t arg2, uint32_t arg3)
          struct fd_elem *cur_file_elem = list_entry (e, struct fd_elem, elem);
          if(cur_file_elem->fd == fd)
          {
+            /* directories cannot be written */
+            if(cur_file_elem->dir != NULL)
+               return -1;
+
             /* write to the file if found */
 	    lock_acquire(&file_lock);   
 	    result = (uint32_t) file_write (cur_file_elem->the_file, buffer, size); 
@@ -424,13 +476,13 @@ uint32_t close_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
         {
            /*close the file, if the fd is found */
 	   lock_acquire(&file_lock);
+           dir_close(cur_file_elem->dir);
            file_close(cur_file_elem->the_file);
 	   lock_release(&file_lock);
            
            /* free the fd_elem and remove from fd_list */
            list_remove(&cur_file_elem->elem);
-	   free(cur_file_elem->filename);
-           free(cur_file_elem);
+           free_fd_elem(cur_file_elem);
 	   return 0;
         }
    }
@@ -439,9 +491,202 @@ uint32_t close_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
 }
 
 
-/* our own method to check the validity of a user pointer */
+//changes the current working directory to dir
+uint32_t chdir_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
+{
+   const char *dir = (char *) arg1;
+   bool result;
+
+   /* verify dir is valid */
+   if(!valid_ptr(dir))
+      thread_exit();
+
+   lock_acquire(&file_lock);
+   result = filesys_chdir(dir);
+   lock_release(&file_lock);
+   return result;
+}
+
+//creates the directory dir
+uint32_t mkdir_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
+{
+   const char *dir = (char *) arg1;
+   bool result;
+
+   /* verify dir is valid */
+   if(!valid_ptr(dir))
+      thread_exit();
+
+   lock_acquire(&file_lock);
+   result = filesys_mkdir(dir);
+   lock_release(&file_lock);
+   return result;
+}
+
+//reads the next entry of the directory open as fd into name
+uint32_t readdir_w(uint32_t arg1, uint32_t arg2, uint32_t arg3 UNUSED)
+{
+   char *name = (char *) arg2;
+   bool result;
+
+   /* verify the name buffer is valid */
+   if(!valid_buffer(name, NAME_MAX + 1, true))
+      thread_exit();
+
+   struct fd_elem *fd_node = lookup_fd((int) arg1);
+   if(fd_node == NULL || fd_node->dir == NULL)
+      return false;
+
+   lock_acquire(&file_lock);
+   result = dir_readdir(fd_node->dir, name);
+   lock_release(&file_lock);
+   return result;
+}
+
+//returns true if fd is open on a directory
+uint32_t isdir_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
+{
+   struct fd_elem *fd_node = lookup_fd((int) arg1);
+   return fd_node != NULL && fd_node->dir != NULL;
+}
+
+//returns the inode number of the file or directory open as fd
+uint32_t inumber_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
+{
+   struct fd_elem *fd_node = lookup_fd((int) arg1);
+   if(fd_node == NULL)
+      return -1;
+   return inode_get_inumber(file_get_inode(fd_node->the_file));
+}
+
+//writes the data of the file open as fd to disk, returns false if fd is bad
+uint32_t fsync_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
+{
+   struct fd_elem *fd_node = lookup_fd((int) arg1);
+   if(fd_node == NULL)
+      return false;
+
+   lock_acquire(&file_lock);
+   file_sync(fd_node->the_file);
+   lock_release(&file_lock);
+   return true;
+}
+
+//writes all unwritten file system data to disk
+uint32_t sync_w(uint32_t arg1 UNUSED, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
+{
+   lock_acquire(&file_lock);
+   filesys_sync();
+   lock_release(&file_lock);
+   return 0; // this value doesn't matter
+}
+
+#ifdef VM
+//maps the open file fd into memory at addr and returns the mapid
+uint32_t mmap_w(uint32_t arg1, uint32_t arg2, uint32_t arg3 UNUSED)
+{
+   int fd = (int) arg1;
+   void *addr = (void *) arg2;
+
+   /* stdin and stdout cannot be mapped */
+   struct fd_elem *fd_node = lookup_fd(fd);
+   if(fd_node == NULL)
+      return MAP_FAILED;
+
+   /* the mapping gets its own file, so it outlives a close(fd) */
+   lock_acquire(&file_lock);
+   struct file *file = file_reopen(fd_node->the_file);
+   lock_release(&file_lock);
+   if(file == NULL)
+      return MAP_FAILED;
+
+   return mmap_map(file, addr);
+}
+
+//unmaps the mapping mapid, writing back the pages that were changed
+uint32_t munmap_w(uint32_t arg1, uint32_t arg2 UNUSED, uint32_t arg3 UNUSED)
+{
+   mapid_t mapid = (mapid_t) arg1;
+   mmap_unmap(mapid);
+   return 0; // this value doesn't matter
+}
+#endif
+
+/* returns the fd_elem for fd in the current thread's fd_list, or NULL */
+static struct fd_elem *lookup_fd(int fd)
+{
+   struct thread *cur = thread_current();
+
+   /* check if fd has even been assigned to a file */
+   if(fd < 2 || fd >= cur->next_fd)
+      return NULL;
+
+   struct list_elem *e;
+   for (e = list_begin (&cur->fd_list); e != list_end (&cur->fd_list);
+        e = list_next (e))
+   {
+        struct fd_elem *cur_file_elem = list_entry (e, struct fd_elem, elem);
+        if(cur_file_elem->fd == fd)
+           return cur_file_elem;
+   }
+   return NULL;
+}
+
+/* frees an fd_elem made by open_w, along with its filename */
+void free_fd_elem(struct fd_elem *fd_node)
+{
+   free(fd_node->filename);
+   kmem_cache_free(fd_elem_cache, fd_node);
+}
+
+/* our own method to check the validity of a user pointer the
+ * kernel will only read through. */
 bool valid_ptr(const void *ptr)
+{
+   return valid_uaddr(ptr, false);
+}
+
+/* checks the user pointer PTR, which the kernel will write
+ * through if WRITE. With VM, a page that is not loaded yet is
+ * faulted in here, and a shared zero page about to be written is
+ * given its own frame, so that the kernel never faults on it
+ * while holding file_lock. */
+static bool valid_uaddr(const void *ptr, bool write UNUSED)
 {
    struct thread *cur = thread_current();
-   return (is_user_vaddr(ptr) && pagedir_get_page(cur->pagedir, ptr) != NULL);
+   if(!is_user_vaddr(ptr))
+      return false;
+   if(pagedir_get_page(cur->pagedir, ptr) != NULL)
+   {
+#ifdef VM
+      // if unsharing failed for want of a frame, the page still
+      // maps the read-only zero frame and the kernel would fault
+      if(write && !page_unshare(ptr) && page_is_shared_zero(ptr))
+         return false;
+#endif
+      return true;
+   }
+#ifdef VM
+   return page_load(ptr, write) || page_grow_stack(ptr, cur->user_esp);
+#else
+   return false;
+#endif
+}
+
+/* checks every page touched by the SIZE bytes at BUFFER, which
+ * the kernel will write to if WRITE */
+bool valid_buffer(const void *buffer, unsigned size, bool write)
+{
+   const uint8_t *start = buffer;
+   const uint8_t *last = start + (size > 0 ? size - 1 : 0);
+   const uint8_t *page;
+
+   /* the buffer may not wrap around */
+   if(last < start)
+      return false;
+
+   for(page = pg_round_down(start); page <= last; page += PGSIZE)
+      if(!valid_uaddr(page < start ? start : page, write))
+         return false;
+   return true;
 }
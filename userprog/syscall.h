@@ -3,7 +3,10 @@
 
 #include <inttypes.h>
 
+struct fd_elem;
+
 void syscall_init (void);
+void free_fd_elem (struct fd_elem *);
 
 /* All system calls have the same type. They take exactly 3 arguments, and return
  * a value, whether the system call needs to return anything, or not.
@@ -14,8 +17,11 @@ typedef uint32_t syscall_wrapper(uint32_t arg1, uint32_t arg2, uint32_t arg3);
  * NOTE: the w is a holdover and doesn't mean anything. */
 syscall_wrapper halt_w, exit_w, exec_w, wait_w,
         create_w, remove_w, open_w, filesize_w,
-        read_w, write_w, seek_w, tell_w, close_w;
-        /* NOTE: must include other calls for later projects */
-        /* code in syscall will like break if they are called */
+        read_w, write_w, seek_w, tell_w, close_w,
+        chdir_w, mkdir_w, readdir_w, isdir_w, inumber_w,
+        fsync_w, sync_w;
+#ifdef VM
+syscall_wrapper mmap_w, munmap_w;
+#endif
 
 #endif /* userprog/syscall.h */
@@ -1,3 +1,4 @@
+#include <stdio.h>
 #include "threads/malloc.h"
 #include "vm/frame.h"
 #include "threads/old_palloc.h"
@@ -27,6 +28,8 @@ frame_table_init(size_t num_frames)
    init_pool(&frame_table.frame_pool, base, num_frames, "frame pool");
 
    // initialize frame table
+   frame_table.used_cnt = 0;
+   frame_table.peak_cnt = 0;
    size_t i;
    frame_table.frames = malloc(sizeof(struct frame_entry)*num_frames);
    struct frame_entry * cur_frame;
@@ -49,6 +52,54 @@ frame_table_free()
    free(frame_table.frames);
 }
 
+/* Returns the frame at KPAGE to the frame pool, resetting its
+ * frame table entry to the unused values. The caller must already
+ * have removed every mapping to the frame.
+ */
+void
+frame_free(void *kpage)
+{
+   struct pool *pool = &frame_table.frame_pool;
+   size_t idx;
+
+   ASSERT(page_from_pool(pool, kpage));
+   idx = pg_no(kpage) - pg_no(pool->base);
+
+   struct frame_entry *cur_frame = &frame_table.frames[idx];
+   cur_frame->pid = -1;
+   cur_frame->page_num = -1;
+   cur_frame->reference = false;
+   cur_frame->dirty = false;
+   cur_frame->resident = false;
+
+   lock_acquire(&pool->lock);
+   ASSERT(bitmap_test(pool->used_map, idx));
+   bitmap_reset(pool->used_map, idx);
+   frame_table.used_cnt--;
+   lock_release(&pool->lock);
+}
+
+/* Returns the number of frames not currently in use. Read without
+ * the pool lock, so it is only a hint.
+ */
+size_t
+frame_free_cnt(void)
+{
+   return bitmap_size(frame_table.frame_pool.used_map) - frame_table.used_cnt;
+}
+
+/* Prints the resident set: user frames in use now and at peak,
+ * out of all the frames in the pool. Pages mapped to the shared
+ * zero frame are not counted, as they take no frame of their own.
+ */
+void
+frame_print_stats(void)
+{
+   printf("Frames: %zu in use, %zu peak, of %zu\n",
+          frame_table.used_cnt, frame_table.peak_cnt,
+          bitmap_size(frame_table.frame_pool.used_map));
+}
+
 /* A function to use with the supplemental page table. This is not called
  * anywhere in our code. 
  */
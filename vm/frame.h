@@ -10,6 +10,9 @@
 
 void frame_table_init(size_t num_frames);
 void frame_table_free(void);
+void frame_free(void *kpage);
+size_t frame_free_cnt(void);
+void frame_print_stats(void);
 
 /* NOTE: NOT IMPLEMENTED. This data structure is not used in our code. */
 struct sup_page_table
@@ -22,6 +25,8 @@ struct frame_table
   struct pool frame_pool;		// bitmap of free areas
   struct lock lock;			// for synchronization of the frame_table
   struct frame_entry * frames;		// array of frame_entry
+  size_t used_cnt;			// frames currently in use
+  size_t peak_cnt;			// most frames ever in use at once
 };
 
 // For supplemental page table. Not used.  
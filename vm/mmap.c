@@ -0,0 +1,171 @@
+#include "vm/mmap.h"
+#include <debug.h>
+#include <round.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/page.h"
+
+/* Memory-mapped files.
+
+   A mapping only creates supplemental page table entries of type
+   PAGE_MMAP; the page-fault path reads each page in on first
+   touch.  Unmapping writes back just the resident pages whose
+   hardware dirty bit is set, so a mapping that is only read
+   costs no disk writes at all. */
+
+static struct mapping *find_mapping (mapid_t);
+static void unmap (struct mapping *);
+
+/* Maps FILE, of which the new mapping takes ownership, into the
+   current process's address space starting at ADDR.  Returns
+   the new mapping's identifier, or MAP_FAILED if FILE is empty,
+   ADDR is null or not page-aligned, or any page of the range
+   would overlap an existing page of the process.  FILE is closed
+   on failure. */
+mapid_t
+mmap_map (struct file *file, void *addr)
+{
+  struct thread *t = thread_current ();
+  struct mapping *m;
+  off_t length;
+  size_t i;
+
+  lock_acquire (&file_lock);
+  length = file_length (file);
+  lock_release (&file_lock);
+
+  if (length == 0 || addr == NULL || pg_ofs (addr) != 0)
+    goto fail;
+
+  /* The range must lie in user space below the stack and not
+     wrap around. */
+  if ((uintptr_t) addr + length < (uintptr_t) addr
+      || !is_user_vaddr ((uint8_t *) addr + length - 1)
+      || page_in_stack ((uint8_t *) addr + length - 1))
+    goto fail;
+
+  m = malloc (sizeof *m);
+  if (m == NULL)
+    goto fail;
+  m->file = file;
+  m->addr = addr;
+  m->page_cnt = DIV_ROUND_UP (length, PGSIZE);
+
+  /* Other mappings are ruled out with one tree search, before
+     any page table entries are made. */
+  if (!range_insert (&t->mapped, &m->range, (uintptr_t) addr,
+                     (uintptr_t) addr + m->page_cnt * PGSIZE))
+    {
+      free (m);
+      goto fail;
+    }
+
+  /* Each page is checked against the code, data and stack in the
+     page table with a single hash lookup, and against any page
+     that is mapped without an entry. */
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      uint8_t *upage = (uint8_t *) addr + i * PGSIZE;
+      off_t ofs = i * PGSIZE;
+      uint32_t read_bytes = length - ofs < PGSIZE ? length - ofs : PGSIZE;
+
+      if (pagedir_get_page (t->pagedir, upage) != NULL
+          || page_add_file (upage, PAGE_MMAP, file, ofs, read_bytes,
+                            true) == NULL)
+        {
+          /* Nothing was faulted in yet, so there is nothing to
+             write back: just drop the entries added so far. */
+          m->page_cnt = i;
+          unmap (m);
+          return MAP_FAILED;
+        }
+    }
+
+  m->id = t->next_mapid++;
+  list_push_back (&t->mappings, &m->elem);
+  return m->id;
+
+ fail:
+  lock_acquire (&file_lock);
+  file_close (file);
+  lock_release (&file_lock);
+  return MAP_FAILED;
+}
+
+/* Unmaps the current process's mapping MAPID, writing back every
+   page that was modified.  Returns false if there is no such
+   mapping. */
+bool
+mmap_unmap (mapid_t mapid)
+{
+  struct mapping *m = find_mapping (mapid);
+  if (m == NULL)
+    return false;
+
+  list_remove (&m->elem);
+  unmap (m);
+  return true;
+}
+
+/* Unmaps every mapping of the current process, as on exit. */
+void
+mmap_unmap_all (void)
+{
+  struct list *mappings = &thread_current ()->mappings;
+
+  while (!list_empty (mappings))
+    {
+      struct list_elem *e = list_pop_front (mappings);
+      unmap (list_entry (e, struct mapping, elem));
+    }
+}
+
+/* Returns the current process's mapping with identifier MAPID,
+   or a null pointer if there is none. */
+static struct mapping *
+find_mapping (mapid_t mapid)
+{
+  struct list *mappings = &thread_current ()->mappings;
+  struct list_elem *e;
+
+  for (e = list_begin (mappings); e != list_end (mappings);
+       e = list_next (e))
+    {
+      struct mapping *m = list_entry (e, struct mapping, elem);
+      if (m->id == mapid)
+        return m;
+    }
+  return NULL;
+}
+
+/* Removes M's pages from the current process, writing back the
+   dirty ones, and then frees M and closes its file.  M must
+   already be off the thread's `mappings' list, if it was ever
+   on it, but still in its `mapped' tree. */
+static void
+unmap (struct mapping *m)
+{
+  struct thread *t = thread_current ();
+  struct pagedir_batch batch;
+  size_t i;
+
+  range_remove (&t->mapped, &m->range);
+  pagedir_batch_init (&batch, t->pagedir);
+  for (i = 0; i < m->page_cnt; i++)
+    {
+      struct page *p = page_lookup ((uint8_t *) m->addr + i * PGSIZE);
+      ASSERT (p != NULL && p->file == m->file);
+      page_remove (p, &batch);
+    }
+  pagedir_batch_flush (&batch);
+
+  lock_acquire (&file_lock);
+  file_close (m->file);
+  lock_release (&file_lock);
+  free (m);
+}
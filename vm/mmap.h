@@ -0,0 +1,30 @@
+#ifndef VM_MMAP_H
+#define VM_MMAP_H
+
+#include <list.h>
+#include <rangetree.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+struct file;
+
+/* Map region identifier. */
+typedef int mapid_t;
+#define MAP_FAILED ((mapid_t) -1)
+
+/* A memory-mapped file. */
+struct mapping
+  {
+    struct list_elem elem;              /* Element in thread's `mappings'. */
+    struct range_elem range;            /* Element in thread's `mapped'. */
+    mapid_t id;                         /* Mapping identifier. */
+    struct file *file;                  /* Mapped file, owned by the mapping. */
+    void *addr;                         /* First mapped user page. */
+    size_t page_cnt;                    /* Number of pages mapped. */
+  };
+
+mapid_t mmap_map (struct file *, void *addr);
+bool mmap_unmap (mapid_t);
+void mmap_unmap_all (void);
+
+#endif /* vm/mmap.h */
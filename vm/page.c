@@ -0,0 +1,547 @@
+#include "vm/page.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/file.h"
+#include "threads/malloc.h"
+#include "threads/interrupt.h"
+#include "threads/palloc.h"
+#include "threads/shrink.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+#include "userprog/pagedir.h"
+#include "userprog/process.h"
+#include "vm/frame.h"
+
+/* Supplemental page table.
+
+   Each process keeps a hash table, keyed by user virtual page,
+   describing every page it may legally touch: pieces of its
+   executable, zero-filled pages, and pages of memory-mapped
+   files.  Entries are created without a frame.  The first access
+   to such a page faults, and page_load() allocates a frame,
+   fills it from the entry's source and maps it.
+
+   Sequential access to a file-backed region would take one trap
+   per page, so a fault on such a page also maps the neighbouring
+   pages of the same file that fall in its fault-around window
+   (see fault_around()).
+
+   A zero-fill page that is first read, rather than written, is
+   mapped read-only to a single zero frame shared by every
+   process.  The first write to it faults again, and
+   page_unshare() then gives the page a private frame.  Sparse,
+   read-mostly bss and heap arrays thus cost no memory.
+
+   The stack is the exception: it has no entries up front.  An
+   access just below the stack pointer that misses the table
+   makes page_grow_stack() add a zero page there, so a stack
+   costs only the pages that are actually touched.
+
+   Pages that fault-around maps go on the `speculative' list.  If
+   the user pool runs dry, page_shrink() unmaps those that nothing
+   has touched since, and gives their frames back; they are still
+   in the page table, so a later access just faults them in
+   again.
+
+   The table is only ever used by the thread that owns it, so it
+   needs no lock of its own.  The `speculative' list is shared by
+   all processes and has `speculative_lock'. */
+
+/* Maximum number of pages in a user stack. */
+size_t page_stack_limit = PAGE_STACK_LIMIT_DEFAULT;
+
+/* Fault-around window given to new file-backed pages. */
+size_t page_fault_around = PAGE_FAULT_AROUND_DEFAULT;
+
+/* Frame of zeros mapped read-only for every zero-fill page that
+   has been read but never written. */
+static void *zero_frame;
+
+/* Pages mapped by fault-around, possibly not touched since. */
+static struct list speculative;
+static struct lock speculative_lock;
+
+/* Gives back the frames of untouched fault-around pages when the
+   user pool runs dry. */
+static shrink_func page_shrink;
+static struct shrinker page_shrinker =
+  { .name = "fault-around", .priority = 0, .shrink = page_shrink,
+    .user = true };
+
+/* Statistics. */
+static long long fault_load_cnt;        /* Pages loaded by a fault. */
+static long long fault_around_cnt;      /* Pages loaded around a fault. */
+static long long fault_around_reclaim_cnt; /* Of those, reclaimed unused. */
+static long long zero_share_cnt;        /* Pages mapped to zero_frame. */
+static long long zero_unshare_cnt;      /* Copy-on-writes of zero_frame. */
+
+static hash_hash_func page_hash;
+static hash_less_func page_less;
+static hash_action_func page_destroy;
+
+static struct page *add_page (void *upage, bool writable);
+static bool map_page (struct page *);
+static void fault_around (struct page *);
+static void read_page (struct page *, void *kpage);
+static void forget_speculative (struct page *);
+
+/* Allocates the shared zero frame and registers the shrinker. */
+void
+page_init (void)
+{
+  zero_frame = palloc_get_page (PAL_ZERO | PAL_ASSERT);
+  list_init (&speculative);
+  lock_init (&speculative_lock);
+  shrinker_register (&page_shrinker);
+}
+
+/* Initializes PAGES as an empty supplemental page table.
+   Returns false if memory allocation fails. */
+bool
+page_table_init (struct hash *pages)
+{
+  return hash_init (pages, page_hash, page_less, NULL);
+}
+
+/* Frees every entry in PAGES, which must belong to the current
+   thread.  Private frames are not released here; they go away
+   with the page directory in pagedir_destroy().  Mappings of the
+   shared zero frame are removed, since it is not the process's
+   to free. */
+void
+page_table_destroy (struct hash *pages)
+{
+  hash_destroy (pages, page_destroy);
+}
+
+/* Returns the supplemental page table entry for the page
+   containing UPAGE in the current thread, or a null pointer if
+   there is none. */
+struct page *
+page_lookup (const void *upage)
+{
+  struct page p;
+  struct hash_elem *e;
+
+  p.upage = pg_round_down (upage);
+  e = hash_find (&thread_current ()->pages, &p.hash_elem);
+  return e != NULL ? hash_entry (e, struct page, hash_elem) : NULL;
+}
+
+/* Adds an entry for UPAGE to the current thread's page table
+   whose contents start out as all zeros.  Returns the new entry,
+   or a null pointer if UPAGE already has one or memory
+   allocation fails. */
+struct page *
+page_add_zero (void *upage, bool writable)
+{
+  struct page *p = add_page (upage, writable);
+  if (p != NULL)
+    {
+      p->type = PAGE_ZERO;
+      p->file = NULL;
+      p->file_ofs = 0;
+      p->read_bytes = 0;
+      p->fault_around = 1;
+    }
+  return p;
+}
+
+/* Adds an entry for UPAGE to the current thread's page table
+   whose first READ_BYTES bytes come from FILE at offset OFS and
+   whose remaining bytes are zero.  TYPE must be PAGE_FILE or
+   PAGE_MMAP.  Returns the new entry, or a null pointer if UPAGE
+   already has one or memory allocation fails. */
+struct page *
+page_add_file (void *upage, enum page_type type, struct file *file,
+               off_t ofs, uint32_t read_bytes, bool writable)
+{
+  struct page *p;
+
+  ASSERT (type == PAGE_FILE || type == PAGE_MMAP);
+  ASSERT (file != NULL);
+  ASSERT (read_bytes <= PGSIZE);
+
+  p = add_page (upage, writable);
+  if (p != NULL)
+    {
+      p->type = type;
+      p->file = file;
+      p->file_ofs = ofs;
+      p->read_bytes = read_bytes;
+      page_set_fault_around (p, page_fault_around);
+    }
+  return p;
+}
+
+/* Removes P from the current thread's page table and frees it.
+   If P is resident, a dirty PAGE_MMAP page is first written back
+   to its file, and then the mapping is cleared and its frame
+   released.  The TLB entry for the page is recorded in BATCH,
+   which the caller must flush. */
+void
+page_remove (struct page *p, struct pagedir_batch *batch)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  void *kpage;
+
+  forget_speculative (p);
+  kpage = pagedir_get_page (pd, p->upage);
+  if (kpage != NULL)
+    {
+      if (p->type == PAGE_MMAP && pagedir_is_dirty (pd, p->upage))
+        {
+          bool held = lock_held_by_current_thread (&file_lock);
+          if (!held)
+            lock_acquire (&file_lock);
+          file_write_at (p->file, kpage, p->read_bytes, p->file_ofs);
+          if (!held)
+            lock_release (&file_lock);
+        }
+
+      /* The frame may go back to the pool before BATCH is
+         flushed.  That is safe: nothing touches P->UPAGE until
+         we return, and any other thread that could reuse the
+         frame runs only after a context switch, which reloads
+         CR3 and flushes the whole TLB anyway. */
+      pagedir_batch_clear_page (batch, p->upage);
+      if (kpage != zero_frame)
+        palloc_free_frame (kpage);
+    }
+
+  hash_delete (&thread_current ()->pages, &p->hash_elem);
+  free (p);
+}
+
+/* Faults in the page containing ADDR for the current thread.
+   WRITE says whether the faulting access was a write; a read of
+   a zero-fill page just maps the shared zero frame.  Returns
+   true if the page is now mapped, false if ADDR is not covered
+   by the supplemental page table or no frame could be
+   obtained. */
+bool
+page_load (const void *addr, bool write)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct page *p;
+  bool locked = false;
+  bool success;
+
+  if (!is_user_vaddr (addr))
+    return false;
+  p = page_lookup (addr);
+  if (p == NULL)
+    return false;
+  if (pagedir_get_page (pd, p->upage) != NULL)
+    return true;
+
+  if (p->type == PAGE_ZERO && !write)
+    {
+      if (!pagedir_set_page (pd, p->upage, zero_frame, false))
+        return false;
+      zero_share_cnt++;
+      return true;
+    }
+
+  /* Hold file_lock across the whole window, not per page. */
+  if (p->file != NULL && !lock_held_by_current_thread (&file_lock))
+    {
+      lock_acquire (&file_lock);
+      locked = true;
+    }
+
+  success = map_page (p);
+  if (success)
+    {
+      fault_load_cnt++;
+      if (p->file != NULL)
+        fault_around (p);
+    }
+
+  if (locked)
+    lock_release (&file_lock);
+  return success;
+}
+
+/* Grows the current thread's stack to cover ADDR, given that
+   the user stack pointer was ESP when the access was made, and
+   faults in the new page.  Returns false if ADDR does not look
+   like a stack access: it must lie within the stack limit and no
+   more than PAGE_STACK_SLOP bytes below ESP. */
+bool
+page_grow_stack (const void *addr, const void *esp)
+{
+  void *upage = pg_round_down (addr);
+
+  if (!page_in_stack (addr)
+      || (const uint8_t *) addr + PAGE_STACK_SLOP < (const uint8_t *) esp)
+    return false;
+
+  return page_add_zero (upage, true) != NULL && page_load (upage, true);
+}
+
+/* Gives the page containing ADDR a private, zeroed frame if it
+   is a writable zero-fill page currently mapped to the shared
+   zero frame, as on the first write to it.  Returns true if
+   successful, false if the page is not such a page or no frame
+   could be obtained. */
+bool
+page_unshare (const void *addr)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  struct page *p;
+
+  if (!is_user_vaddr (addr))
+    return false;
+  p = page_lookup (addr);
+  if (p == NULL || p->type != PAGE_ZERO || !p->writable
+      || pagedir_get_page (pd, p->upage) != zero_frame)
+    return false;
+
+  pagedir_clear_page (pd, p->upage);
+  if (!map_page (p))
+    {
+      pagedir_set_page (pd, p->upage, zero_frame, false);
+      return false;
+    }
+  zero_unshare_cnt++;
+  return true;
+}
+
+/* Returns true if the page containing ADDR is mapped to the
+   shared zero frame, and so must not be written through. */
+bool
+page_is_shared_zero (const void *addr)
+{
+  return (is_user_vaddr (addr)
+          && pagedir_get_page (thread_current ()->pagedir,
+                               pg_round_down (addr)) == zero_frame);
+}
+
+/* Returns true if ADDR lies in the part of the address space
+   reserved for the user stack. */
+bool
+page_in_stack (const void *addr)
+{
+  return (is_user_vaddr (addr)
+          && (uintptr_t) PHYS_BASE - (uintptr_t) addr
+             <= page_stack_limit * PGSIZE);
+}
+
+/* Sets P's fault-around window to WINDOW pages, clamped to
+   PAGE_FAULT_AROUND_MAX.  A window of 0 or 1 disables
+   fault-around for P. */
+void
+page_set_fault_around (struct page *p, size_t window)
+{
+  p->fault_around = window < PAGE_FAULT_AROUND_MAX ? window
+                                                   : PAGE_FAULT_AROUND_MAX;
+}
+
+/* Prints paging statistics. */
+void
+page_print_stats (void)
+{
+  printf ("Paging: %lld pages faulted in, %lld more by fault-around\n",
+          fault_load_cnt, fault_around_cnt);
+  printf ("Paging: %lld zero pages shared, %lld copied on write\n",
+          zero_share_cnt, zero_unshare_cnt);
+  printf ("Paging: %lld fault-around pages reclaimed untouched\n",
+          fault_around_reclaim_cnt);
+}
+
+/* Allocates a frame for P, fills it and maps it.  Returns false
+   if no frame is available.  If P is file-backed, the caller
+   must hold file_lock. */
+static bool
+map_page (struct page *p)
+{
+  void *kpage = palloc_page (PAL_USER, p->upage, p->writable);
+  if (kpage == NULL)
+    return false;
+  read_page (p, kpage);
+  return true;
+}
+
+/* Having just loaded file-backed page P, also maps every other
+   non-resident page of the same file in P's fault-around window.
+   The window is aligned to its own size, so a sequential scan
+   takes one fault per window instead of one per page.  Stops
+   once no more than a window's worth of frames is free, so that
+   pages nobody asked for do not take the frames left for real
+   faults.  The caller must hold file_lock. */
+static void
+fault_around (struct page *p)
+{
+  uint32_t *pd = thread_current ()->pagedir;
+  size_t window = p->fault_around;
+  uint8_t *start, *upage;
+
+  if (window <= 1)
+    return;
+
+  start = (uint8_t *) p->upage - pg_no (p->upage) % window * PGSIZE;
+  for (upage = start; upage < start + window * PGSIZE; upage += PGSIZE)
+    {
+      struct page *q;
+
+      if (upage == p->upage || !is_user_vaddr (upage))
+        continue;
+      q = page_lookup (upage);
+      if (q == NULL || q->file != p->file
+          || pagedir_get_page (pd, upage) != NULL)
+        continue;
+      if (frame_free_cnt () <= window || !map_page (q))
+        break;
+      fault_around_cnt++;
+
+      lock_acquire (&speculative_lock);
+      list_push_back (&speculative, &q->spec_elem);
+      q->speculative = true;
+      lock_release (&speculative_lock);
+    }
+}
+
+/* Takes P off the `speculative' list, if it is there, so that
+   page_shrink() leaves it alone from now on.  Must be called by
+   P's owner before it unmaps P or frees it. */
+static void
+forget_speculative (struct page *p)
+{
+  lock_acquire (&speculative_lock);
+  if (p->speculative)
+    {
+      list_remove (&p->spec_elem);
+      p->speculative = false;
+    }
+  lock_release (&speculative_lock);
+}
+
+/* Unmaps up to PAGE_CNT pages that fault-around mapped and that
+   have been neither read nor written since, and frees their
+   frames.  Pages that have been touched just leave the list.
+   Returns the number of frames freed. */
+static size_t
+page_shrink (size_t page_cnt)
+{
+  size_t freed = 0;
+
+  if (lock_held_by_current_thread (&speculative_lock)
+      || !lock_try_acquire (&speculative_lock))
+    return 0;
+
+  while (freed < page_cnt && !list_empty (&speculative))
+    {
+      struct page *p = list_entry (list_pop_front (&speculative),
+                                   struct page, spec_elem);
+      enum intr_level old_level;
+      void *kpage;
+
+      p->speculative = false;
+
+      /* The owner cannot run, and so cannot touch the page,
+         between the check and the unmapping. */
+      old_level = intr_disable ();
+      kpage = pagedir_get_page (p->pagedir, p->upage);
+      if (kpage != NULL
+          && !pagedir_is_accessed (p->pagedir, p->upage)
+          && !pagedir_is_dirty (p->pagedir, p->upage))
+        pagedir_clear_page (p->pagedir, p->upage);
+      else
+        kpage = NULL;
+      intr_set_level (old_level);
+
+      if (kpage != NULL)
+        {
+          palloc_free_frame (kpage);
+          freed++;
+        }
+    }
+  fault_around_reclaim_cnt += freed;
+  lock_release (&speculative_lock);
+  return freed;
+}
+
+/* Fills KPAGE, the frame for P, with P's initial contents.
+   KPAGE is written through its kernel address, so the user
+   mapping of P is not marked dirty.  If P is file-backed, the
+   caller must hold file_lock. */
+static void
+read_page (struct page *p, void *kpage)
+{
+  if (p->read_bytes > 0)
+    {
+      off_t n;
+
+      ASSERT (lock_held_by_current_thread (&file_lock));
+      n = file_read_at (p->file, kpage, p->read_bytes, p->file_ofs);
+
+      /* A short read means the file shrank; zero the rest. */
+      if (n < 0)
+        n = 0;
+      memset ((uint8_t *) kpage + n, 0, PGSIZE - n);
+    }
+  else
+    memset (kpage, 0, PGSIZE);
+}
+
+/* Allocates an entry for UPAGE and inserts it into the current
+   thread's page table.  The caller fills in the source fields.
+   Returns a null pointer if UPAGE already has an entry or memory
+   allocation fails. */
+static struct page *
+add_page (void *upage, bool writable)
+{
+  struct page *p;
+
+  ASSERT (pg_ofs (upage) == 0);
+  ASSERT (is_user_vaddr (upage));
+
+  p = malloc (sizeof *p);
+  if (p == NULL)
+    return NULL;
+  p->upage = upage;
+  p->writable = writable;
+  p->pagedir = thread_current ()->pagedir;
+  p->speculative = false;
+  if (hash_insert (&thread_current ()->pages, &p->hash_elem) != NULL)
+    {
+      free (p);
+      return NULL;
+    }
+  return p;
+}
+
+/* Returns a hash value for the page in E. */
+static unsigned
+page_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  const struct page *p = hash_entry (e, struct page, hash_elem);
+  return hash_int (pg_no (p->upage));
+}
+
+/* Returns true if page A precedes page B. */
+static bool
+page_less (const struct hash_elem *a_, const struct hash_elem *b_,
+           void *aux UNUSED)
+{
+  const struct page *a = hash_entry (a_, struct page, hash_elem);
+  const struct page *b = hash_entry (b_, struct page, hash_elem);
+  return a->upage < b->upage;
+}
+
+/* Frees the page in E, first unmapping it if it is mapped to the
+   shared zero frame. */
+static void
+page_destroy (struct hash_elem *e, void *aux UNUSED)
+{
+  struct page *p = hash_entry (e, struct page, hash_elem);
+  uint32_t *pd = thread_current ()->pagedir;
+
+  forget_speculative (p);
+  if (pd != NULL && pagedir_get_page (pd, p->upage) == zero_frame)
+    pagedir_clear_page (pd, p->upage);
+  free (p);
+}
@@ -0,0 +1,80 @@
+#ifndef VM_PAGE_H
+#define VM_PAGE_H
+
+#include <hash.h>
+#include <list.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "filesys/off_t.h"
+
+struct file;
+struct pagedir_batch;
+
+/* Where the contents of a page come from when it is faulted
+   in. */
+enum page_type
+  {
+    PAGE_ZERO,                  /* All zeros (bss, stack). */
+    PAGE_FILE,                  /* Executable segment, never written back. */
+    PAGE_MMAP                   /* Memory-mapped file, written back if dirty. */
+  };
+
+/* A supplemental page table entry.  One per user virtual page
+   that the process is allowed to touch, whether or not it is
+   currently backed by a frame. */
+struct page
+  {
+    struct hash_elem hash_elem;         /* Element in thread's `pages'. */
+    void *upage;                        /* User virtual address. */
+    bool writable;                      /* Mapped read/write? */
+    enum page_type type;                /* Source of the contents. */
+    struct file *file;                  /* Backing file, if any. */
+    off_t file_ofs;                     /* Offset of page in FILE. */
+    uint32_t read_bytes;                /* Bytes read from FILE, rest zero. */
+    uint8_t fault_around;               /* Fault-around window, in pages. */
+    uint32_t *pagedir;                  /* Owning process's page directory. */
+    bool speculative;                   /* In `speculative' list? */
+    struct list_elem spec_elem;         /* Element in `speculative' list. */
+  };
+
+/* Default for page_stack_limit: 8 MB of stack. */
+#define PAGE_STACK_LIMIT_DEFAULT 2048
+
+/* How far below the stack pointer an access may land and still
+   count as a stack access.  PUSHA writes 32 bytes below %esp
+   before %esp is decremented. */
+#define PAGE_STACK_SLOP 32
+
+/* Default and maximum fault-around window, in pages.  A fault
+   on a file-backed page also maps the other pages of the same
+   file in the aligned window of this many pages around it. */
+#define PAGE_FAULT_AROUND_DEFAULT 8
+#define PAGE_FAULT_AROUND_MAX 64
+
+/* Fault-around window given to new file-backed pages.
+   Controlled by kernel command-line option "-fa". */
+extern size_t page_fault_around;
+
+/* Maximum number of pages in a user stack.
+   Controlled by kernel command-line option "-sl". */
+extern size_t page_stack_limit;
+
+void page_init (void);
+bool page_table_init (struct hash *);
+void page_table_destroy (struct hash *);
+
+struct page *page_lookup (const void *upage);
+struct page *page_add_zero (void *upage, bool writable);
+struct page *page_add_file (void *upage, enum page_type, struct file *,
+                            off_t ofs, uint32_t read_bytes, bool writable);
+void page_remove (struct page *, struct pagedir_batch *);
+bool page_load (const void *addr, bool write);
+bool page_grow_stack (const void *addr, const void *esp);
+bool page_unshare (const void *addr);
+bool page_is_shared_zero (const void *addr);
+bool page_in_stack (const void *addr);
+void page_set_fault_around (struct page *, size_t window);
+void page_print_stats (void);
+
+#endif /* vm/page.h */